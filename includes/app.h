@@ -55,7 +55,8 @@ public:
 
 			break;
 
-		case SDL_WINDOWEVENT: m_r.refresh(); break;
+		case SDL_WINDOWEVENT:
+		case SDL_RENDER_TARGETS_RESET: m_r.refresh(); break;
 		}
 
 		m_menu.event(e, m_w, m_r) && m_canvas.event(e, m_ek, m_w, m_r);
@@ -63,6 +64,7 @@ public:
 
 	void update()
 	{
+		m_canvas.update(m_r);
 	}
 
 	void render()
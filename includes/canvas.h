@@ -19,11 +19,22 @@ public:
 		init_painting(c);
 		init_select();
 		init_typing(r, c);
+		init_regen(c.regen);
 
 		debug_init(r, c);
 	}
 
-	void draw(const Renderer &r)
+	void update(Renderer &r)
+	{
+		update_residency(r, c);
+		update_paint(r, c);
+		apply_regen(r, c);
+		apply_tiles(r, c);
+		update_atlas(r, c);
+		update_journal(c);
+	}
+
+	void draw(Renderer &r)
 	{
 		draw_strokes(r, c);
 		draw_texts(r, c);
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <span>
+#include <optional>
+#include <algorithm>
+
+#include "layout.h"
+#include "transform.h"
+
+using namespace ctl;
+
+static constexpr auto ATLAS_PAD = 1; // Transparent gutter against filtering bleed
+
+/**
+ * @brief Find a free spot on a page using its shelves
+ *
+ * @param p Page to pack into
+ * @param d Size to fit including padding
+ *
+ * @return Top-left position if it fits
+ */
+inline auto atlas_fit(AtlasPage &p, mth::Dim<int> d) -> std::optional<mth::Point<int>>
+{
+	AtlasShelf *best = nullptr;
+
+	for (auto &s : p.shelves) // Lowest shelf the item fits on
+		if (d.h <= s.h && s.x + d.w <= ATLAS_SIZE && (!best || s.h < best->h))
+			best = &s;
+
+	if (!best)
+	{
+		const auto y = p.shelves.empty() ? 0 : p.shelves.back().y + p.shelves.back().h;
+
+		if (y + d.h > ATLAS_SIZE)
+			return std::nullopt;
+
+		best = &p.shelves.emplace_back(AtlasShelf{ .y = y, .h = d.h, .x = 0 });
+	}
+
+	const mth::Point<int> pos = { best->x, best->y };
+	best->x += d.w;
+	p.used += (int64_t)d.w * d.h;
+
+	return pos;
+}
+
+/**
+ * @brief Copy a texture area into the atlas
+ *
+ * @param r Copy the pixels
+ * @param a Atlas to pack into
+ * @param t Source texture
+ * @param src Area of the source
+ * @param skip Page not to use
+ *
+ * @return Packed region or page -1 when too large
+ */
+inline auto atlas_insert(Renderer &r, TextureAtlas &a, const Renderer::Texture &t, mth::Rect<int> src, int skip = -1)
+	-> AtlasRegion
+{
+	if (src.w > ATLAS_ITEM_MAX || src.h > ATLAS_ITEM_MAX)
+		return {};
+
+	const mth::Dim<int> d = { src.w + ATLAS_PAD * 2, src.h + ATLAS_PAD * 2 };
+
+	const auto place = [&](int i, mth::Point<int> p)
+	{
+		const mth::Rect<int> dst = { p.x + ATLAS_PAD, p.y + ATLAS_PAD, src.w, src.h };
+		r.copy_frame(t, src, a.pages[i].data, dst);
+
+		return AtlasRegion{ .page = i, .rect = dst };
+	};
+
+	for (int i = 0; i < (int)a.pages.size(); ++i)
+		if (i != skip && a.pages[i].data)
+			if (const auto p = atlas_fit(a.pages[i], d); p)
+				return place(i, *p);
+
+	// Reuse an emptied slot or open a new page
+	auto e = std::find_if(a.pages.begin(), a.pages.end(), [](const AtlasPage &p) { return !p.data; });
+
+	if (e != a.pages.end() && std::distance(a.pages.begin(), e) == skip)
+		e = std::find_if(e + 1, a.pages.end(), [](const AtlasPage &p) { return !p.data; });
+
+	if (e == a.pages.end())
+		e = a.pages.emplace(a.pages.end());
+
+	e->data = r.create_atlas_page(ATLAS_SIZE);
+
+	const auto i = (int)std::distance(a.pages.begin(), e);
+	return place(i, *atlas_fit(*e, d));
+}
+
+/**
+ * @brief Release a packed region
+ *
+ * @param a Atlas the region is in
+ * @param rg Region to release (reset afterwards)
+ */
+inline void atlas_free(TextureAtlas &a, AtlasRegion &rg)
+{
+	if (rg.page == -1)
+		return;
+
+	assert(rg.page < (int)a.pages.size() && "Region of an unknown page.");
+
+	auto &p = a.pages[rg.page];
+	p.freed += (int64_t)(rg.rect.w + ATLAS_PAD * 2) * (rg.rect.h + ATLAS_PAD * 2);
+
+	if (p.freed >= p.used) // Nothing left, drop the page
+		p = AtlasPage{};
+
+	rg = {};
+}
+
+/**
+ * @brief Get the share of a page still covered by live regions
+ */
+inline auto atlas_occupancy(const AtlasPage &p) -> float
+{
+	return (float)(p.used - p.freed) / ((int64_t)ATLAS_SIZE * ATLAS_SIZE);
+}
+
+/**
+ * @brief Get the video memory held by the atlas, whole pages stay allocated while any region is live
+ */
+inline auto atlas_bytes(const TextureAtlas &a) -> int64_t
+{
+	return std::count_if(a.pages.begin(), a.pages.end(), [](const AtlasPage &p) { return p.data != nullptr; }) *
+		   ATLAS_PAGE_BYTES;
+}
+
+/**
+ * @brief Find the page most worth repacking
+ *
+ * A page is repacked once half of its packed pixels were freed, or when it holds so little that its regions are
+ * better merged into the other pages.
+ *
+ * @param a Atlas to look through
+ *
+ * @return Least occupied page with freed space or -1 when none qualifies
+ */
+inline auto atlas_fragmented(const TextureAtlas &a) -> int
+{
+	const auto pages =
+		std::count_if(a.pages.begin(), a.pages.end(), [](const AtlasPage &p) { return p.data != nullptr; });
+
+	int	  best = -1;
+	float occ  = 1.F;
+
+	for (int i = 0; i < (int)a.pages.size(); ++i)
+	{
+		const auto &p = a.pages[i];
+
+		if (!p.data || p.freed == 0)
+			continue;
+
+		const auto o = atlas_occupancy(p);
+
+		if ((p.freed * 2 > p.used || (pages > 1 && o < ATLAS_OCCUPANCY)) && (best == -1 || o < occ))
+		{
+			best = i;
+			occ	 = o;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * @brief Move all regions of a page to other pages and drop it
+ *
+ * @param r Copy the pixels
+ * @param a Atlas to compact
+ * @param page Page to empty
+ * @param dbs Texture dbs referencing the atlas
+ */
+inline void atlas_compact(Renderer &r, TextureAtlas &a, int page, std::span<WorldTextureDB *const> dbs)
+{
+	const auto old = std::move(a.pages[page].data);
+	a.pages[page]  = AtlasPage{};
+
+	for (auto *wts : dbs)
+		for (auto &wt : *wts)
+			if (wt.region.page == page)
+				wt.region = atlas_insert(r, a, old, wt.region.rect, page);
+}
+
+/**
+ * @brief Queue a newly generated texture to be packed
+ *
+ * @param a Atlas to pack into
+ * @param i Index of the texture
+ */
+inline void atlas_queue(TextureAtlas &a, size_t i)
+{
+	a.pending.push_back(i);
+}
+
+/**
+ * @brief Forget an erased texture, the last one takes its index (mirrors erase)
+ *
+ * @param a Atlas with the queue
+ * @param i Index of the erased texture
+ * @param last Index of the last texture before the erase
+ */
+inline void atlas_erase(TextureAtlas &a, size_t i, size_t last)
+{
+	std::erase(a.pending, i);
+
+	for (auto &p : a.pending)
+		if (p == last)
+			p = i;
+}
+
+/**
+ * @brief Pack the queued textures and release replaced regions
+ *
+ * @param r Copy the pixels
+ * @param a Atlas to pack into
+ * @param wts Textures the queue refers to
+ */
+inline void atlas_pack(Renderer &r, TextureAtlas &a, WorldTextureDB &wts)
+{
+	for (const auto i : a.pending)
+	{
+		auto &wt = wts[i];
+
+		if (!wt.data) // Queued twice or evicted
+			continue;
+
+		atlas_free(a, wt.region); // Texture was regenerated
+
+		const auto s = r.get_texture_size(wt.data);
+
+		if (s.w > ATLAS_ITEM_MAX || s.h > ATLAS_ITEM_MAX)
+			continue;
+
+		wt.region = atlas_insert(r, a, wt.data, { 0, 0, s.w, s.h });
+		wt.data.reset();
+	}
+
+	a.pending.clear();
+}
+
+/**
+ * @brief Draw textures batched by atlas page
+ *
+ * @param r Draw the textures
+ * @param cam Transform to the screen
+ * @param a Atlas the textures are in
+ * @param wts Textures to draw
+ * @param idx Indices of the textures
+ */
+inline void draw_world_textures(const Renderer &r, const sdl::Camera2D &cam, const TextureAtlas &a,
+								const WorldTextureDB &wts, std::span<const size_t> idx)
+{
+	std::vector<std::vector<mth::Rect<int>>> srcs(a.pages.size()), dsts(a.pages.size());
+	std::vector<mth::Rect<int>>				 waiting;
+
+	std::vector<mth::Rect<float>> dims(idx.size());
+	std::vector<mth::Rect<int>>	  worlds(idx.size());
+
+	for (size_t n = 0; n < idx.size(); ++n) dims[n] = wts[idx[n]].dim;
+	world_screen_batch(cam, dims, worlds);
+
+	for (size_t n = 0; n < idx.size(); ++n)
+	{
+		const auto &wt	  = wts[idx[n]];
+		const auto &world = worlds[n];
+
+		if (wt.data) // Not packed (yet)
+			r.draw_texture(wt.data, world);
+
+		else if (wt.region.page != -1)
+		{
+			srcs[wt.region.page].push_back(wt.region.rect);
+			dsts[wt.region.page].push_back(world);
+		}
+
+		else // Still being generated
+			waiting.push_back(world);
+	}
+
+	r.set_draw_color(sdl::GRAY);
+	for (const auto &w : waiting) r.draw_rect(w);
+
+	for (size_t p = 0; p < a.pages.size(); ++p)
+		if (!srcs[p].empty())
+			r.draw_frames(a.pages[p].data, srcs[p], dsts[p]);
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <span>
+#include <bit>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "layout.h"
+#include "text_buffer.h"
+
+using namespace ctl;
+
+static_assert(std::endian::native == std::endian::little, "Files are written in host order, which must be little-endian.");
+
+// -----------------------------------------------------------------------------
+// Saving
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Append a chunk padded to FILE_ALIGN
+ *
+ * @param out File contents to extend
+ * @param type Chunk type
+ * @param data Payload
+ * @param size Payload bytes
+ */
+inline void write_chunk(std::string &out, ChunkType type, const void *data, size_t size)
+{
+	const ChunkHeader h = { .type = type, .size = (uint32_t)size };
+
+	out.append((const char *)&h, sizeof h);
+	out.append((const char *)data, size);
+	out.resize((out.size() + FILE_ALIGN - 1) / FILE_ALIGN * FILE_ALIGN, '\0');
+}
+
+/**
+ * @brief Save the canvas as binary chunks
+ * <header magic version>
+ * <chunk type size> payload, padded ...
+ *
+ * @param c Get the camera, strokes, texts and journal position
+ * @param filename File to write
+ */
+inline void save_binary(const SaveState &c, const char *filename)
+{
+	static_assert(sizeof(SDL_Color) == 4, "SDL_Color must be 4 bytes long.");
+
+	std::string out;
+
+	const FileHeader h = { .magic = FILE_MAGIC, .version = FILE_VERSION };
+	out.append((const char *)&h, sizeof h);
+
+	const CameraRecord cam = { .x = c.cam.loc.x, .y = c.cam.loc.y, .scale = c.cam.scale };
+	write_chunk(out, ChunkType::CAMERA, &cam, sizeof cam);
+
+	const DocumentRecord doc = { .id = c.id, .seq = c.seq };
+	write_chunk(out, ChunkType::DOCUMENT, &doc, sizeof doc);
+
+	std::vector<StrokeRecord> strokes;
+	std::string				  pts; // Without the points of erased strokes
+
+	strokes.reserve(c.swls.size());
+	pts.reserve((c.swls.pts.size() - c.swls.dead) * 2); // Most moves take a byte per axis
+
+	for (size_t i = 0; i < c.swls.size(); ++i)
+	{
+		const auto &t  = c.swts[i];
+		const auto &l  = c.swls.lines[i];
+		const auto &li = c.swlis[i];
+
+		uint32_t color;
+		std::memcpy(&color, &li.color, sizeof color);
+
+		strokes.push_back({ .x		= t.dim.x,
+							.y		= t.dim.y,
+							.w		= t.dim.w,
+							.h		= t.dim.h,
+							.radius = li.radius,
+							.scale	= li.scale,
+							.step	= l.step,
+							.color	= color,
+							.offset = (uint32_t)pts.size(),
+							.count	= l.count });
+
+		c.swls.pack(i, pts);
+	}
+
+	write_chunk(out, ChunkType::STROKES, strokes.data(), strokes.size() * sizeof(StrokeRecord));
+	write_chunk(out, ChunkType::PACKED_POINTS, pts.data(), pts.size());
+
+	std::vector<TextRecord> texts;
+	std::string				data;
+
+	texts.reserve(c.txwts.size());
+
+	for (size_t i = 0; i < c.txwts.size(); ++i)
+	{
+		const auto s = text_string(c.txwtxis[i].text);
+
+		texts.push_back({ .x	  = c.txwts[i].dim.x,
+						  .y	  = c.txwts[i].dim.y,
+						  .scale  = c.txwtxis[i].scale,
+						  .offset = (uint32_t)data.size(),
+						  .size	  = (uint32_t)s.size() });
+
+		data += s;
+	}
+
+	write_chunk(out, ChunkType::TEXTS, texts.data(), texts.size() * sizeof(TextRecord));
+	write_chunk(out, ChunkType::TEXT_DATA, data.data(), data.size());
+
+	std::ofstream f(filename, std::ios::binary);
+
+	if (!f.write(out.data(), (std::streamsize)out.size()))
+		throw std::runtime_error("Could not write the file.");
+}
+
+// -----------------------------------------------------------------------------
+// Loading
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Check if file contents start as a binary save
+ */
+inline auto is_binary(std::span<const char> d) -> bool
+{
+	return d.size() >= sizeof(FileHeader) && std::equal(FILE_MAGIC.begin(), FILE_MAGIC.end(), d.begin());
+}
+
+/**
+ * @brief Copy a record out of a chunk
+ *
+ * @param d Chunk payload
+ * @param i Record index
+ */
+template<typename T>
+inline auto read_record(std::span<const char> d, size_t i) -> T
+{
+	T t;
+	std::memcpy(&t, d.data() + i * sizeof(T), sizeof(T));
+
+	return t;
+}
+
+/**
+ * @brief Add strokes whose points are packed
+ *
+ * The points are unpacked a stroke at a time on first read, so only the records are read here.
+ *
+ * @param c Location to store to
+ * @param strokes StrokeRecord chunk
+ * @param packed Packed points chunk
+ * @param f Mapped file
+ */
+inline void load_packed(SaveState &c, std::span<const char> strokes, std::span<const char> packed,
+						std::shared_ptr<const MappedFile> f)
+{
+	const auto n	= strokes.size() / sizeof(StrokeRecord);
+	const auto lazy = !c.swls.file; // Otherwise another file is mapped already
+
+	size_t total = 0;
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		const auto s = read_record<StrokeRecord>(strokes, i);
+
+		if (s.offset > packed.size() || s.count > (packed.size() - s.offset) / 2) // Points take at least 2 bytes
+			throw std::runtime_error("A line points outside of the points.");
+
+		size_t pos = s.offset;
+		skip_points(packed, pos, s.count); // Unpacked on first use, corruption must show now
+
+		total += s.count;
+	}
+
+	if (total > UINT32_MAX)
+		throw std::runtime_error("The file has too many points.");
+
+	if (lazy)
+	{
+		c.swls.file		= f;
+		c.swls.packed	= packed;
+		c.swls.unpacked = std::shared_ptr<LinePoint[]>(new LinePoint[total]); // Left uninitialized
+		c.swls.mapped	= c.swls.unpacked.get();
+	}
+
+	for (size_t i = 0, o = 0; i < n; ++i)
+	{
+		const auto s = read_record<StrokeRecord>(strokes, i);
+
+		SDL_Color color;
+		std::memcpy(&color, &s.color, sizeof color);
+
+		if (lazy)
+		{
+			c.swls.lines.push_back({ .offset		= (uint32_t)o,
+									 .count			= s.count,
+									 .step			= s.step,
+									 .mapped		= true,
+									 .packed		= true,
+									 .packed_offset = s.offset });
+			o += s.count;
+		}
+		else
+		{
+			size_t pos = s.offset;
+			c.swls.push_packed(packed, pos, s.count, s.step);
+		}
+
+		c.swts.push_back({ .dim = { s.x, s.y, s.w, s.h } });
+		c.swlis.push_back({ s.radius, s.scale, color });
+	}
+}
+
+/**
+ * @brief Add strokes whose points stay in the mapped file (version 1)
+ *
+ * @param c Location to store to
+ * @param strokes StrokeRecord chunk
+ * @param pts LinePoint chunk
+ * @param f Mapped file
+ */
+inline void load_mapped(SaveState &c, std::span<const char> strokes, std::span<const char> pts,
+						std::shared_ptr<const MappedFile> f)
+{
+	const auto n_pts = pts.size() / sizeof(LinePoint);
+	const auto map	 = !c.swls.file; // Otherwise another file is mapped already
+	const auto base	 = map ? 0 : c.swls.pts.size();
+
+	if (map)
+	{
+		c.swls.file	  = f;
+		c.swls.mapped = reinterpret_cast<const LinePoint *>(pts.data()); // Chunks are aligned in the file
+	}
+	else
+	{
+		c.swls.pts.resize(base + n_pts);
+		std::memcpy(c.swls.pts.data() + base, pts.data(), n_pts * sizeof(LinePoint));
+	}
+
+	for (size_t i = 0; i < strokes.size() / sizeof(StrokeRecord); ++i)
+	{
+		const auto s = read_record<StrokeRecord>(strokes, i);
+
+		if ((size_t)s.offset + s.count > n_pts)
+			throw std::runtime_error("A line points outside of the points.");
+
+		SDL_Color color;
+		std::memcpy(&color, &s.color, sizeof color);
+
+		c.swts.push_back({ .dim = { s.x, s.y, s.w, s.h } });
+		c.swls.lines.push_back(
+			{ .offset = (uint32_t)(base + s.offset), .count = s.count, .step = s.step, .mapped = map });
+		c.swlis.push_back({ s.radius, s.scale, color });
+	}
+}
+
+/**
+ * @brief Load binary chunks into the canvas (unknown chunks are skipped)
+ *
+ * Only the records are read. Packed points are unpacked & raw points of version 1 files paged in from the mapped file
+ * once a stroke is drawn or erased.
+ *
+ * @param c Location to store to
+ * @param f Mapped file
+ */
+inline void load_binary(CanvasContext &c, std::shared_ptr<const MappedFile> f)
+{
+	const auto d = std::span(f->data, f->size);
+
+	if (read_record<FileHeader>(d, 0).version > FILE_VERSION)
+		throw std::runtime_error("The file is from a newer version.");
+
+	std::span<const char> strokes, pts, packed, texts, data;
+
+	for (size_t pos = sizeof(FileHeader); pos + sizeof(ChunkHeader) <= d.size();)
+	{
+		const auto h = read_record<ChunkHeader>(d.subspan(pos), 0);
+		pos += sizeof(ChunkHeader);
+
+		if (h.size > d.size() - pos)
+			throw std::runtime_error("A chunk is cut off.");
+
+		const auto p = d.subspan(pos, h.size);
+		pos			 = (pos + h.size + FILE_ALIGN - 1) / FILE_ALIGN * FILE_ALIGN;
+
+		switch (h.type)
+		{
+		case ChunkType::CAMERA:
+			if (p.size() >= sizeof(CameraRecord))
+			{
+				const auto cam = read_record<CameraRecord>(p, 0);
+				c.cam.loc	   = { cam.x, cam.y };
+				c.cam.scale	   = cam.scale;
+			}
+
+			break;
+
+		case ChunkType::DOCUMENT:
+			if (p.size() >= sizeof(DocumentRecord))
+			{
+				const auto doc = read_record<DocumentRecord>(p, 0);
+				c.id		   = doc.id;
+				c.seq		   = doc.seq;
+			}
+
+			break;
+
+		case ChunkType::STROKES: strokes = p; break;
+		case ChunkType::POINTS: pts = p; break;
+		case ChunkType::PACKED_POINTS: packed = p; break;
+		case ChunkType::TEXTS: texts = p; break;
+		case ChunkType::TEXT_DATA: data = p; break;
+		}
+	}
+
+	if (packed.data() != nullptr)
+		load_packed(c, strokes, packed, f);
+	else
+		load_mapped(c, strokes, pts, f);
+
+	for (size_t i = 0; i < texts.size() / sizeof(TextRecord); ++i)
+	{
+		const auto t = read_record<TextRecord>(texts, i);
+
+		if ((size_t)t.offset + t.size > data.size())
+			throw std::runtime_error("A text points outside of the text data.");
+
+		c.txwtxis.push_back({ .text = text_buffer({ data.data() + t.offset, t.size }), .scale = t.scale });
+		c.txwts.push_back({ .dim = { t.x, t.y, 0.F, 0.F } });
+	}
+}
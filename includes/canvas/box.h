@@ -5,43 +5,44 @@
 #include "text.h"
 #include "event.h"
 #include "layout.h"
+#include "spatial.h"
 #include "window.h"
 
 using namespace ctl;
 
 /**
- * @brief Find a texture colliding with a world point
+ * @brief Find the topmost texture colliding with a world point
  *
+ * @param g Spatial index of the textures
  * @param ts Texture to compare with
  * @param wp World point to use
  *
- * @return std::find_if
+ * @return Index of the texture if found
  */
-inline auto find_texture(WorldTextureDB &ts, mth::Point<float> wp)
+inline auto find_texture(const SpatialGrid &g, const WorldTextureDB &ts, mth::Point<float> wp)
 {
-	return std::find_if(ts.rbegin(), ts.rend(), [wp](const WorldTexture &wt) { return mth::collision(wt.dim, wp); });
+	return grid_query(g, ts, wp);
 }
 
 /**
  * @brief Select a texture in a defined order (TODO)
  *
  * @param wts Strokes to search in
+ * @param wg Spatial index of the strokes
  * @param wtxs Texts to search in
+ * @param wtxg Spatial index of the texts
  * @param wp 
  *
  * @return 
  */
-inline auto start_selecting(WorldTextureDB &wts, WorldTextureDB &wtxs, mth::Point<float> wp) -> Select
+inline auto start_selecting(WorldTextureDB &wts, const SpatialGrid &wg, WorldTextureDB &wtxs, const SpatialGrid &wtxg,
+							mth::Point<float> wp) -> Select
 {
-	auto t = find_texture(wts, wp);
+	if (const auto t = find_texture(wg, wts, wp); t)
+		return Select{ .idx = *t, .wt = &wts[*t], .type = CanvasType::STROKE };
 
-	if (t != wts.rend())
-		return Select{ .idx = (size_t)std::distance(wts.begin(), t.base()) - 1, .wt = &*t, .type = CanvasType::STROKE };
-
-	t = find_texture(wtxs, wp);
-
-	if (t != wtxs.rend())
-		return Select{ .idx = (size_t)std::distance(wtxs.begin(), t.base()) - 1, .wt = &*t, .type = CanvasType::TEXT };
+	if (const auto t = find_texture(wtxg, wtxs, wp); t)
+		return Select{ .idx = *t, .wt = &wtxs[*t], .type = CanvasType::TEXT };
 
 	return Select{ .idx = (size_t)-1, .wt = nullptr, .type = CanvasType::NONE };
 }
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+// -----------------------------------------------------------------------------
+// Points
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Map signed to unsigned so small moves either way stay small
+ */
+inline auto zigzag(int16_t v) -> uint32_t
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 15);
+}
+
+/**
+ * @brief Undo zigzag
+ */
+inline auto unzigzag(uint32_t v) -> int16_t
+{
+	return (int16_t)((v >> 1) ^ -(v & 1));
+}
+
+/**
+ * @brief Append a varint, 7 bits per byte with the high bit set on all but the last
+ */
+inline void put_varint(std::string &out, uint32_t v)
+{
+	for (; v >= 0x80; v >>= 7) out += (char)(v | 0x80);
+	out += (char)v;
+}
+
+/**
+ * @brief Append the quantized moves of a stroke as zigzag varints, mostly a byte each
+ *
+ * @param ps Moves of the stroke (LinePoint)
+ * @param out Packed bytes to extend
+ */
+template<typename Point>
+inline void pack_points(std::span<const Point> ps, std::string &out)
+{
+	for (const auto &p : ps)
+	{
+		put_varint(out, zigzag(p.dx));
+		put_varint(out, zigzag(p.dy));
+	}
+}
+
+/**
+ * @brief Read a varint
+ *
+ * @param d Packed bytes
+ * @param pos Position to read at, moved past the varint
+ */
+inline auto get_varint(std::span<const char> d, size_t &pos) -> uint32_t
+{
+	uint32_t v = 0;
+
+	for (int shift = 0; shift < 21; shift += 7) // Moves take at most 3 bytes
+	{
+		if (pos == d.size())
+			throw std::runtime_error("Packed points are cut off.");
+
+		const auto b = (uint8_t)d[pos++];
+		v |= (uint32_t)(b & 0x7F) << shift;
+
+		if (b < 0x80)
+			return v;
+	}
+
+	throw std::runtime_error("Packed points are corrupt.");
+}
+
+/**
+ * @brief Unpack the moves of a stroke
+ *
+ * @param d Packed bytes
+ * @param pos Position of the stroke, moved past it
+ * @param out Moves to fill (LinePoint)
+ */
+template<typename Point>
+inline void unpack_points(std::span<const char> d, size_t &pos, std::span<Point> out)
+{
+	const auto *b = reinterpret_cast<const uint8_t *>(d.data());
+
+	for (auto &p : out)
+		if (pos + 2 <= d.size() && (b[pos] | b[pos + 1]) < 0x80) // Both moves in single bytes, the common case
+		{
+			p = { unzigzag(b[pos]), unzigzag(b[pos + 1]) };
+			pos += 2;
+		}
+		else
+		{
+			const auto dx = get_varint(d, pos);
+			p			  = { unzigzag(dx), unzigzag(get_varint(d, pos)) };
+		}
+}
+
+/**
+ * @brief Find the end of a packed stroke without unpacking it, checking that it unpacks
+ *
+ * @param d Packed bytes
+ * @param pos Position of the stroke, moved past it
+ * @param count Points of the stroke
+ */
+inline void skip_points(std::span<const char> d, size_t &pos, uint32_t count)
+{
+	for (uint32_t i = 0; i < count * 2; ++i)
+		if (get_varint(d, pos) > 0xFFFF) // Outside of the 16 bit moves
+			throw std::runtime_error("Packed points are corrupt.");
+}
+
+// -----------------------------------------------------------------------------
+// Base64
+// -----------------------------------------------------------------------------
+
+static constexpr std::string_view BASE64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * @brief Append bytes as base64, for text formats
+ */
+inline void base64_encode(std::string_view d, std::string &out)
+{
+	size_t i = 0;
+
+	for (; i + 3 <= d.size(); i += 3)
+	{
+		const auto v = (uint32_t)(uint8_t)d[i] << 16 | (uint32_t)(uint8_t)d[i + 1] << 8 | (uint8_t)d[i + 2];
+		out.append({ BASE64[v >> 18], BASE64[v >> 12 & 63], BASE64[v >> 6 & 63], BASE64[v & 63] });
+	}
+
+	if (d.size() - i == 1)
+	{
+		const auto v = (uint32_t)(uint8_t)d[i] << 16;
+		out.append({ BASE64[v >> 18], BASE64[v >> 12 & 63], '=', '=' });
+	}
+	else if (d.size() - i == 2)
+	{
+		const auto v = (uint32_t)(uint8_t)d[i] << 16 | (uint32_t)(uint8_t)d[i + 1] << 8;
+		out.append({ BASE64[v >> 18], BASE64[v >> 12 & 63], BASE64[v >> 6 & 63], '=' });
+	}
+}
+
+/**
+ * @brief Decode base64 (padding optional)
+ *
+ * @param s Text to decode
+ * @param out Bytes, replaced
+ */
+inline void base64_decode(std::string_view s, std::string &out)
+{
+	static constexpr auto table = []
+	{
+		std::array<int8_t, 256> t = {};
+		t.fill(-1);
+
+		for (size_t i = 0; i < BASE64.size(); ++i) t[(uint8_t)BASE64[i]] = (int8_t)i;
+
+		return t;
+	}();
+
+	while (s.ends_with('=')) s.remove_suffix(1);
+
+	out.clear();
+	out.reserve(s.size() * 3 / 4);
+
+	uint32_t v	  = 0;
+	int		 bits = 0;
+
+	for (const auto ch : s)
+	{
+		const auto x = table[(uint8_t)ch];
+
+		if (x < 0)
+			throw std::runtime_error("Invalid base64.");
+
+		v = v << 6 | (uint32_t)x;
+		bits += 6;
+
+		if (bits >= 8)
+		{
+			bits -= 8;
+			out += (char)(v >> bits);
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Utf-8
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Get the byte length of the utf-8 sequence starting with a byte
+ */
+constexpr auto utf8_length(char c) -> size_t
+{
+	const auto b = (unsigned char)c;
+
+	if (b >> 5 == 0x6)
+		return 2;
+	if (b >> 4 == 0xE)
+		return 3;
+	if (b >> 3 == 0x1E)
+		return 4;
+
+	return 1; // Ascii & stray continuation bytes
+}
+
+/**
+ * @brief Decode one utf-8 sequence into its code point
+ */
+constexpr auto utf8_decode(std::string_view s) -> uint32_t
+{
+	if (s.size() == 1)
+		return (unsigned char)s[0];
+
+	uint32_t cp = (unsigned char)s[0] & (0x7F >> s.size());
+	for (size_t i = 1; i < s.size(); ++i) cp = cp << 6 | ((unsigned char)s[i] & 0x3F);
+
+	return cp;
+}
+
+/**
+ * @brief Encode a code point as utf-8
+ */
+inline auto utf8_encode(uint32_t cp) -> std::string
+{
+	if (cp < 0x80)
+		return { (char)cp };
+	if (cp < 0x800)
+		return { (char)(0xC0 | cp >> 6), (char)(0x80 | (cp & 0x3F)) };
+	if (cp < 0x10000)
+		return { (char)(0xE0 | cp >> 12), (char)(0x80 | (cp >> 6 & 0x3F)), (char)(0x80 | (cp & 0x3F)) };
+
+	return { (char)(0xF0 | cp >> 18), (char)(0x80 | (cp >> 12 & 0x3F)), (char)(0x80 | (cp >> 6 & 0x3F)),
+			 (char)(0x80 | (cp & 0x3F)) };
+}
@@ -2,6 +2,7 @@
 
 #include <charconv>
 #include "layout.h"
+#include "transform.h"
 
 inline void debug_init(Renderer &r, CanvasContext &c)
 {
@@ -24,9 +25,11 @@ inline void debug_event(const SDL_Event &e, Renderer &r, CanvasContext &c)
 		++p;
 		*std::to_chars(p, b + 32, wp.y).ptr = '\0';
 
+		const auto s1 = r.get_texture_size(c.debug.mouse);
 		c.debug.mouse = r.create_text(c.txf.data, b);
+		const auto s2 = r.get_texture_size(c.debug.mouse);
 
-		r.refresh();
+		r.refresh({ 0, 0, std::max(s1.w, s2.w), std::max(s1.h, s2.h) });
 	}
 #endif
 }
@@ -37,22 +40,30 @@ inline void debug_draw(const Renderer &r, const sdl::Camera2D &cam, const Canvas
 	const auto s = r.get_texture_size(c.debug.mouse);
 	r.draw_texture(c.debug.mouse, { 0, 0, s.w, s.h });
 
-	for (size_t i = 0; i < c.swts.size(); ++i)
+	std::vector<mth::Rect<float>> ws;
+	std::vector<mth::Rect<int>>	  ss;
+
+	const auto draw_rects = [&]
 	{
-		r.set_draw_color(sdl::GREEN);
-		const auto w = cam.world_screen(c.swts[i].dim);
-		r.draw_rect(w);
-
-		r.set_draw_color(sdl::ORANGE);
-		for (auto p : c.swls[i].points)
-		{
-			const mth::Rect<float> s = { c.swts[i].dim.x + p.x - c.swlis[i].radius,
-										 c.swts[i].dim.y + p.y - c.swlis[i].radius, c.swlis[i].radius * 2,
-										 c.swlis[i].radius * 2 };
-
-			const auto w = cam.world_screen(s);
-			r.draw_rect(w);
-		}
-	}
+		ss.resize(ws.size());
+		world_screen_batch(cam, ws, ss);
+
+		for (const auto &s : ss) r.draw_rect(s);
+		ws.clear();
+	};
+
+	for (const auto &wt : c.swts) ws.push_back(wt.dim);
+
+	r.set_draw_color(sdl::GREEN);
+	draw_rects();
+
+	for (size_t i = 0; i < c.swts.size(); ++i)
+		if (!c.swls.lines[i].packed) // Only strokes already needed elsewhere
+			for (auto p : c.swls.points(i))
+				ws.push_back({ c.swts[i].dim.x + p.x - c.swlis[i].radius, c.swts[i].dim.y + p.y - c.swlis[i].radius,
+							   c.swlis[i].radius * 2, c.swlis[i].radius * 2 });
+
+	r.set_draw_color(sdl::ORANGE);
+	draw_rects();
 #endif
 }
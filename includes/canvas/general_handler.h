@@ -8,16 +8,24 @@
 #include "layout.h"
 #include "stroke.h"
 #include "save.h"
+#include "journal.h"
 #include "text.h"
+#include "tile.h"
+#include "atlas.h"
+#include "regen.h"
+#include "residency.h"
 
 /**
  * @brief Zoom the camera onto the mouse point
  */
 inline void zoom_camera(CanvasContext &c, float strength)
 {
-	const auto s = std::clamp(c.cam.scale * (1.F + strength / 10.F), 0.1F, 10.F);
+	const auto s = std::clamp(c.cam.scale * (1.F + strength / 10.F), ZOOM_MIN, ZOOM_MAX);
 	c.cam.set_zoom(s, sdl::mouse_position());
 	change_radius(c.cam, c.ssli, c.ssli.i_rad);
+
+	c.zoom_tick = SDL_GetTicks();
+	c.lod_dirty = true;
 }
 
 /**
@@ -26,6 +34,24 @@ inline void zoom_camera(CanvasContext &c, float strength)
 inline void move_camera(CanvasContext &c, float dx, float dy)
 {
 	c.cam.translate(dx, dy);
+	c.lod_dirty = true; // Strokes coming into view
+
+	c.residency.pan		 = { dx / c.cam.scale, dy / c.cam.scale };
+	c.residency.pan_tick = SDL_GetTicks();
+}
+
+/**
+ * @brief Switch to the next stroke render path
+ */
+inline void cycle_stroke_render(CanvasContext &c)
+{
+	c.stroke_render = (StrokeRender)(((int)c.stroke_render + 1) % STROKE_RENDERS);
+
+	if (c.stroke_render == StrokeRender::VECTOR && !Renderer::GEOMETRY) // Needs SDL_RenderGeometry
+		c.stroke_render = (StrokeRender)(((int)c.stroke_render + 1) % STROKE_RENDERS);
+
+	c.lod_dirty = true;
+	ctl::print("Stroke render: %i\n", (int)c.stroke_render);
 }
 
 /**
@@ -37,12 +63,70 @@ inline auto got_filename(CanvasContext &c)
 }
 
 /**
- * @brief Reload the textures based on their info
+ * @brief Simplify all strokes and report the points removed
+ */
+inline void simplify_strokes(CanvasContext &c)
+{
+	const auto st = simplify_lines(c.swls, c.swlis);
+
+	for (auto &l : c.swlods) l.clear(); // Built again from the new points
+	for (auto &b : c.swbs) b = {};
+	for (auto &m : c.swms) m = {};	   // Tessellated again when drawn
+	drop_tiles(c.tiles, c.regen);
+
+	if (got_filename(c)) // Not journaled, written out with the whole canvas
+		save_background(c, c.save_path);
+
+	ctl::print("Simplified strokes: %zu -> %zu points (%zu removed)\n", st.before, st.after, st.before - st.after);
+	ctl::print("Drawn strokes: %zu -> %zu points (%zu removed)\n", c.simplify.before, c.simplify.after,
+			   c.simplify.before - c.simplify.after);
+}
+
+/**
+ * @brief Drop the stroke textures & tiles, reloaded in the background once they come into view
  */
 inline void recreate_textures(Renderer &r, CanvasContext &c)
 {
-	regen_strokes(r, c.swts, c.swls, c.swlis);
-	regen_texts(r, c.txf, c.txwts, c.txwtxis);
+	c.atlas.clear();
+	drop_textures(c.regen, c.swts);
+	drop_tiles(c.tiles, c.regen);
+}
+
+/**
+ * @brief Lay out all texts and update their dimensions
+ */
+inline void relayout_texts(Renderer &r, CanvasContext &c)
+{
+	c.txls.resize(c.txwtxis.size());
+
+	for (size_t i = 0; i < c.txwtxis.size(); ++i)
+	{
+		c.txls[i]	   = layout_text(r, c.glyphs, c.txf, c.txwtxis[i].text);
+		c.txwts[i].dim = text_dim(c.txwts[i].dim.pos(), c.txls[i], c.txwtxis[i].scale);
+	}
+}
+
+/**
+ * @brief Move new stroke textures into the atlas and repack a fragmented page
+ */
+inline void update_atlas(Renderer &r, CanvasContext &c)
+{
+	atlas_pack(r, c.atlas, c.swts);
+
+	if (const auto i = atlas_fragmented(c.atlas); i != -1) // One per frame
+	{
+		const std::array dbs = { &c.swts };
+		atlas_compact(r, c.atlas, i, dbs);
+	}
+}
+
+/**
+ * @brief Rebuild the spatial indices from the texture dimensions
+ */
+inline void reindex(CanvasContext &c)
+{
+	grid_rebuild(c.swg, c.swts);
+	grid_rebuild(c.txwg, c.txwts);
 }
 
 /**
@@ -69,6 +153,28 @@ inline void handle_general(const SDL_Event &e, const KeyEvent &ke, const Window
 
 		break;
 
+	case SDL_RENDER_TARGETS_RESET: // Atlas pages lost their content
+		recreate_textures(r, c);
+		reload_glyphs(r, c.glyphs, c.txf);
+		r.refresh();
+
+		break;
+
+	case SDL_KEYDOWN:
+		if (e.key.keysym.sym == SDLK_F2)
+		{
+			cycle_stroke_render(c);
+			r.refresh();
+		}
+
+		else if (e.key.keysym.sym == SDLK_F3)
+		{
+			simplify_strokes(c);
+			r.refresh();
+		}
+
+		break;
+
 	case SDL_MOUSEWHEEL:
 	{
 		zoom_camera(c, (float)e.wheel.y);
@@ -84,14 +190,14 @@ inline void handle_general(const SDL_Event &e, const KeyEvent &ke, const Window
 			break;
 		}
 
-		save(c, c.save_path.c_str());
+		quicksave(c, c.save_path);
 
 		break;
 
 	case EVENT_SAVE:
 		if (const auto filename = open_file_save(); filename)
 		{
-			save(c, filename->c_str());
+			save_journaled(c, filename->c_str());
 			cache_filename(c, filename->c_str());
 		}
 
@@ -100,13 +206,23 @@ inline void handle_general(const SDL_Event &e, const KeyEvent &ke, const Window
 	case EVENT_LOAD:
 		if (const auto filename = open_file_load(); filename)
 		{
-			clear(c.swts, c.swls, c.swlis, c.txwts, c.txwtxis);
-
-			CATCH_LOG(load(c, filename->c_str()));
+			close_journal(c); // Changes so far are kept in the old one
+			clear(c.swts, c.swls, c.swlis, c.swlods, c.swbs, c.swms, c.swg, c.txwts, c.txwtxis, c.txls, c.txwg, c.tiles, c.atlas);
+			c.id = c.seq = 0;
+			c.save_path.clear(); // A partly loaded canvas must not be quicksaved over any file
+
+			// The journal replays changes made after the last full save, only on top of a complete load
+			CATCH_LOG(load(c, filename->c_str()); open_journal(c, filename->c_str());
+					  cache_filename(c, filename->c_str()));
+			change_radius(c.cam, c.ssli, c.ssli.i_rad); // Binary files restore the camera
+			c.lod_dirty = true;
+			c.swlods.resize(c.swls.size());
+			c.swbs.resize(c.swls.size());
+			c.swms.resize(c.swls.size());
 			recreate_textures(r, c);
+			relayout_texts(r, c);
+			reindex(c);
 			r.refresh();
-
-			cache_filename(c, filename->c_str());
 		}
 
 		break;
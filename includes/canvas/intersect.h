@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include "layout.h"
+
+using namespace ctl;
+
+/**
+ * @brief Check if a line crosses a segment of a polyline
+ *
+ * @param xs X of the points
+ * @param ys Y of the points
+ * @param i Point the segment starts at
+ * @param p Line start
+ * @param q Line end
+ */
+inline auto segment_crosses(const float *xs, const float *ys, size_t i, mth::Point<float> p, mth::Point<float> q)
+	-> bool
+{
+	const auto dx = q.x - p.x, dy = q.y - p.y;
+	const auto ex = xs[i + 1] - xs[i], ey = ys[i + 1] - ys[i];
+
+	const auto d1 = dx * (ys[i] - p.y) - dy * (xs[i] - p.x); // Sides of the segment ends to the line
+	const auto d2 = dx * (ys[i + 1] - p.y) - dy * (xs[i + 1] - p.x);
+	const auto d3 = ex * (p.y - ys[i]) - ey * (p.x - xs[i]); // Sides of the line ends to the segment
+	const auto d4 = ex * (q.y - ys[i]) - ey * (q.x - xs[i]);
+
+	return d1 * d2 <= 0.F && d3 * d4 <= 0.F && !(d1 == 0.F && d2 == 0.F); // Collinear never crosses
+}
+
+/**
+ * @brief Check if a line crosses any segment of a polyline, several segments at once
+ *
+ * @param xs X of the points
+ * @param ys Y of the points
+ * @param n Number of points
+ * @param p Line start
+ * @param q Line end
+ */
+inline auto polyline_crosses(const float *xs, const float *ys, size_t n, mth::Point<float> p, mth::Point<float> q)
+	-> bool
+{
+	size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64) // Baseline on x86-64, wider lanes gain little on chunks
+	{
+		const auto px = _mm_set1_ps(p.x), py = _mm_set1_ps(p.y);
+		const auto qx = _mm_set1_ps(q.x), qy = _mm_set1_ps(q.y);
+		const auto dx = _mm_sub_ps(qx, px), dy = _mm_sub_ps(qy, py);
+		const auto z  = _mm_setzero_ps();
+
+		for (; i + 4 < n; i += 4)
+		{
+			const auto ax = _mm_loadu_ps(xs + i), ay = _mm_loadu_ps(ys + i);
+			const auto bx = _mm_loadu_ps(xs + i + 1), by = _mm_loadu_ps(ys + i + 1);
+			const auto ex = _mm_sub_ps(bx, ax), ey = _mm_sub_ps(by, ay);
+
+			const auto d1 = _mm_sub_ps(_mm_mul_ps(dx, _mm_sub_ps(ay, py)), _mm_mul_ps(dy, _mm_sub_ps(ax, px)));
+			const auto d2 = _mm_sub_ps(_mm_mul_ps(dx, _mm_sub_ps(by, py)), _mm_mul_ps(dy, _mm_sub_ps(bx, px)));
+			const auto d3 = _mm_sub_ps(_mm_mul_ps(ex, _mm_sub_ps(py, ay)), _mm_mul_ps(ey, _mm_sub_ps(px, ax)));
+			const auto d4 = _mm_sub_ps(_mm_mul_ps(ex, _mm_sub_ps(qy, ay)), _mm_mul_ps(ey, _mm_sub_ps(qx, ax)));
+
+			const auto cross = _mm_and_ps(_mm_cmple_ps(_mm_mul_ps(d1, d2), z), _mm_cmple_ps(_mm_mul_ps(d3, d4), z));
+			const auto coll	 = _mm_and_ps(_mm_cmpeq_ps(d1, z), _mm_cmpeq_ps(d2, z));
+
+			if (_mm_movemask_ps(_mm_andnot_ps(coll, cross)) != 0)
+				return true;
+		}
+	}
+#endif
+
+	for (; i + 1 < n; ++i) // Remaining segments (or all without simd)
+		if (segment_crosses(xs, ys, i, p, q))
+			return true;
+
+	return false;
+}
+
+/**
+ * @brief Decode points into separate coordinate arrays
+ *
+ * @param ps Points to decode
+ * @param xs X output (resized)
+ * @param ys Y output (resized)
+ */
+inline void decode_points(const LinePoints &ps, std::vector<float> &xs, std::vector<float> &ys)
+{
+	xs.resize(ps.size());
+	ys.resize(ps.size());
+
+	size_t i = 0;
+
+	for (const auto p : ps)
+	{
+		xs[i] = p.x;
+		ys[i] = p.y;
+		++i;
+	}
+}
+
+/**
+ * @brief Split a line into chunks of SEGMENT_CHUNK segments with their bounds
+ *
+ * @param ps Points to split
+ * @param level Detail level of the points
+ */
+inline auto build_bounds(const LinePoints &ps, int level) -> LineBounds
+{
+	LineBounds lb = { .level = level };
+
+	uint32_t k = 0;
+
+	for (auto it = ps.begin(); it != ps.end(); ++it, ++k)
+	{
+		const auto p = *it;
+
+		if (k % SEGMENT_CHUNK == 0 && k + 1 < ps.size())
+			lb.chunks.push_back({ .area = { p.x, p.y, 0.F, 0.F }, .first = k, .x = it.x, .y = it.y });
+
+		for (auto c = lb.chunks.rbegin(); c != lb.chunks.rend() && c->first + SEGMENT_CHUNK >= k; ++c)
+		{
+			auto &a = c->area; // The last point of a chunk is the first of the next
+
+			const auto x2 = std::max(a.x + a.w, p.x), y2 = std::max(a.y + a.h, p.y);
+			a.x = std::min(a.x, p.x);
+			a.y = std::min(a.y, p.y);
+			a.w = x2 - a.x;
+			a.h = y2 - a.y;
+		}
+	}
+
+	for (auto &c : lb.chunks) // Keep straight chunks from having no area
+		c.area = { c.area.x - ps.step, c.area.y - ps.step, c.area.w + ps.step * 2, c.area.h + ps.step * 2 };
+
+	return lb;
+}
+
+/**
+ * @brief Get the points of a chunk, including the first point of the next
+ */
+inline auto chunk_points(const LinePoints &ps, const LineChunk &c) -> LinePoints
+{
+	return { .data	= ps.data + c.first,
+			 .count = std::min<uint32_t>(SEGMENT_CHUNK + 1, ps.count - c.first),
+			 .step	= ps.step,
+			 .x		= c.x,
+			 .y		= c.y };
+}
@@ -0,0 +1,550 @@
+#pragma once
+
+#include <span>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <string_view>
+
+#include "layout.h"
+#include "text_buffer.h"
+#include "save.h"
+
+using namespace ctl;
+
+// -----------------------------------------------------------------------------
+// Writing
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Append a change to the journal, written out right away
+ *
+ * @param c Get the journal and count the change
+ * @param op Kind of change
+ * @param parts Payload pieces
+ */
+inline void journal_append(CanvasContext &c, JournalOp op, std::initializer_list<std::string_view> parts)
+{
+	auto &j = c.journal;
+	++c.seq; // Counted even without a journal, the next full save includes it
+
+	if (!j.f.is_open() && !j.saver.joinable())
+		return;
+
+	OpHeader h = { .op = op, .size = 0, .seq = c.seq };
+	for (const auto &p : parts) h.size += (uint32_t)p.size();
+
+	std::string rec((const char *)&h, sizeof h);
+	for (const auto &p : parts) rec += p;
+
+	if (j.saver.joinable()) // Kept for the journal that follows the saved file
+		j.tail += rec;
+
+	if (!j.f.is_open())
+		return;
+
+	if (!j.f.write(rec.data(), (std::streamsize)rec.size()).flush()) // A crash loses at most this change
+	{
+		ctl::print("Journal: could not write change %ju, saving the whole canvas instead\n", (uintmax_t)c.seq);
+
+		j.f.close(); // A partly written record must stay the last one
+		j.lost		= true;
+		j.save_tick = SDL_GetTicks() - AUTOSAVE_INTERVAL; // Due right away
+
+		return;
+	}
+
+	j.bytes += rec.size();
+}
+
+/**
+ * @brief View a record as payload bytes
+ */
+template<typename T>
+inline auto record_bytes(const T &t) -> std::string_view
+{
+	return { (const char *)&t, sizeof t };
+}
+
+/**
+ * @brief Journal the newest stroke
+ */
+inline void journal_add_stroke(CanvasContext &c)
+{
+	const auto	i = c.swts.size() - 1;
+	const auto &l = c.swls.lines[i];
+
+	uint32_t color;
+	std::memcpy(&color, &c.swlis[i].color, sizeof color);
+
+	const StrokeRecord s = { .x		 = c.swts[i].dim.x,
+							 .y		 = c.swts[i].dim.y,
+							 .w		 = c.swts[i].dim.w,
+							 .h		 = c.swts[i].dim.h,
+							 .radius = c.swlis[i].radius,
+							 .scale	 = c.swlis[i].scale,
+							 .step	 = l.step,
+							 .color	 = color,
+							 .offset = 0,
+							 .count	 = l.count };
+
+	const auto ps = c.swls.points(i);
+	journal_append(c, JournalOp::ADD_STROKE,
+				   { record_bytes(s), { (const char *)ps.data, ps.count * sizeof(LinePoint) } });
+}
+
+/**
+ * @brief Journal the erase of a stroke, before it happens
+ */
+inline void journal_erase_stroke(CanvasContext &c, size_t i)
+{
+	const auto idx = (uint32_t)i;
+	journal_append(c, JournalOp::ERASE_STROKE, { record_bytes(idx) });
+}
+
+/**
+ * @brief Journal the position of the selection
+ */
+inline void journal_move(CanvasContext &c)
+{
+	const MoveRecord m = {
+		.type = c.select.type, .idx = (uint32_t)c.select.idx, .x = c.select.wt->dim.x, .y = c.select.wt->dim.y
+	};
+
+	journal_append(c, JournalOp::MOVE, { record_bytes(m) });
+}
+
+/**
+ * @brief Journal the newest text
+ */
+inline void journal_add_text(CanvasContext &c)
+{
+	const auto i = c.txwts.size() - 1;
+	const auto s = text_string(c.txwtxis[i].text);
+
+	const TextRecord t = { .x		= c.txwts[i].dim.x,
+						   .y		= c.txwts[i].dim.y,
+						   .scale	= c.txwtxis[i].scale,
+						   .offset = 0,
+						   .size	= (uint32_t)s.size() };
+
+	journal_append(c, JournalOp::ADD_TEXT, { record_bytes(t), s });
+}
+
+/**
+ * @brief Journal an edit of a text, before it happens
+ *
+ * @param c Get the journal
+ * @param i Text to edit
+ * @param erase Bytes to remove before the cursor
+ * @param insert Text to insert at the cursor
+ */
+inline void journal_edit_text(CanvasContext &c, size_t i, size_t erase, std::string_view insert)
+{
+	const auto		 gap = c.txwtxis[i].text.gap;
+	const EditRecord e	 = { .idx	= (uint32_t)i,
+							 .pos	= (uint32_t)gap,
+							 .erase = (uint32_t)std::min(erase, gap), // As clamped by the edit
+							 .size	= (uint32_t)insert.size() };
+
+	journal_append(c, JournalOp::EDIT_TEXT, { record_bytes(e), insert });
+}
+
+/**
+ * @brief Journal the erase of a text, before it happens
+ */
+inline void journal_erase_text(CanvasContext &c, size_t i)
+{
+	const auto idx = (uint32_t)i;
+	journal_append(c, JournalOp::ERASE_TEXT, { record_bytes(idx) });
+}
+
+// -----------------------------------------------------------------------------
+// Replaying
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Apply a journaled change to the dbs (spatial indices and layouts are rebuilt after)
+ *
+ * @param c Dbs to change
+ * @param op Kind of change
+ * @param p Payload
+ */
+inline void replay_op(SaveState &c, JournalOp op, std::span<const char> p)
+{
+	const auto index = [&p](size_t n)
+	{
+		const auto i = read_record<uint32_t>(p, 0);
+
+		if (i >= n)
+			throw std::runtime_error("A journal change refers to a missing item.");
+
+		return (size_t)i;
+	};
+
+	switch (op)
+	{
+	case JournalOp::ADD_STROKE:
+	{
+		const auto s = read_record<StrokeRecord>(p, 0);
+
+		if (p.size() != sizeof s + s.count * sizeof(LinePoint))
+			throw std::runtime_error("A journaled line has the wrong size.");
+
+		SDL_Color color;
+		std::memcpy(&color, &s.color, sizeof color);
+
+		const auto o = c.swls.pts.size();
+		c.swls.pts.resize(o + s.count);
+		std::memcpy(c.swls.pts.data() + o, p.data() + sizeof s, s.count * sizeof(LinePoint));
+
+		c.swts.push_back({ .dim = { s.x, s.y, s.w, s.h } });
+		c.swls.lines.push_back({ .offset = (uint32_t)o, .count = s.count, .step = s.step });
+		c.swlis.push_back({ s.radius, s.scale, color });
+
+		break;
+	}
+
+	case JournalOp::ERASE_STROKE: erase(index(c.swts.size()), c.swts, c.swls, c.swlis); break;
+
+	case JournalOp::MOVE:
+	{
+		const auto m   = read_record<MoveRecord>(p, 0);
+		auto	  &wts = m.type == CanvasType::STROKE ? c.swts : c.txwts;
+
+		if (m.idx >= wts.size())
+			throw std::runtime_error("A journal change refers to a missing item.");
+
+		wts[m.idx].dim.x = m.x;
+		wts[m.idx].dim.y = m.y;
+
+		break;
+	}
+
+	case JournalOp::ADD_TEXT:
+	{
+		const auto t = read_record<TextRecord>(p, 0);
+
+		c.txwtxis.push_back({ .text = text_buffer({ p.data() + sizeof t, p.size() - sizeof t }), .scale = t.scale });
+		c.txwts.push_back({ .dim = { t.x, t.y, 0.F, 0.F } });
+
+		break;
+	}
+
+	case JournalOp::EDIT_TEXT:
+	{
+		if (p.size() < sizeof(EditRecord))
+			throw std::runtime_error("A journaled text edit has the wrong size.");
+
+		const auto e = read_record<EditRecord>(p, 0);
+		auto	  &b = c.txwtxis[index(c.txwtxis.size())].text;
+
+		if (e.pos > text_size(b) || e.erase > e.pos || e.size != p.size() - sizeof e) // Would be clamped silently
+			throw std::runtime_error("A journaled text edit is outside of the text.");
+
+		text_move(b, e.pos);
+		text_erase(b, e.erase);
+		text_insert(b, { p.data() + sizeof e, p.size() - sizeof e });
+
+		break;
+	}
+
+	case JournalOp::ERASE_TEXT: erase(index(c.txwts.size()), c.txwts, c.txwtxis); break;
+	}
+}
+
+/**
+ * @brief Apply the changes of a journal newer than the loaded file
+ *
+ * @param c Loaded dbs, get the document id & last change
+ * @param d Journal contents
+ *
+ * @return False if the journal belongs to another document
+ */
+inline auto replay_journal(SaveState &c, std::span<const char> d) -> bool
+{
+	if (d.size() < sizeof(JournalHeader))
+		return false;
+
+	const auto h = read_record<JournalHeader>(d, 0);
+
+	if (h.magic != JOURNAL_MAGIC || h.id != c.id)
+		return false;
+
+	for (size_t pos = sizeof h; pos + sizeof(OpHeader) <= d.size();)
+	{
+		const auto op = read_record<OpHeader>(d.subspan(pos), 0);
+		pos += sizeof op;
+
+		if (op.size > d.size() - pos) // Cut off by a crash while writing
+			break;
+
+		if (op.seq > c.seq) // Older ones are in the file already
+		{
+			replay_op(c, op.op, d.subspan(pos, op.size));
+			c.seq = op.seq;
+		}
+
+		pos += op.size;
+	}
+
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// Opening
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Get the journal file of a canvas file
+ */
+inline auto journal_path(std::string_view filename) -> std::string
+{
+	return std::string(filename) + ".journal";
+}
+
+/**
+ * @brief Replace the journal with a new file holding a header and changes
+ *
+ * The current journal stays open if the new one cannot be written.
+ *
+ * @param c Get the document id & the journal
+ * @param path Journal file to write
+ * @param tail Changes to keep
+ */
+inline void write_journal(CanvasContext &c, const std::string &path, std::string_view tail)
+{
+	auto &j = c.journal;
+
+	const JournalHeader h = { .magic = JOURNAL_MAGIC, .version = FILE_VERSION, .id = c.id };
+	const auto			tmp = path + ".tmp";
+
+	{
+		std::ofstream f(tmp, std::ios::binary);
+
+		if (!f.write((const char *)&h, sizeof h).write(tail.data(), (std::streamsize)tail.size()))
+			throw std::runtime_error("Could not write the journal.");
+	}
+
+	sync_file(tmp.c_str());
+
+	j.f.close(); // Files can't be replaced while open on Windows
+
+	std::error_code ec;
+	std::filesystem::rename(tmp, path, ec);
+
+	if (ec)
+	{
+		if (!j.path.empty())
+			j.f.open(j.path, std::ios::binary | std::ios::app);
+
+		throw std::runtime_error("Could not replace the journal: " + ec.message());
+	}
+
+	j.path = path;
+	j.f.open(j.path, std::ios::binary | std::ios::app);
+	j.bytes = sizeof h + tail.size();
+	j.lost	= false;
+}
+
+// -----------------------------------------------------------------------------
+// Saving
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Copy what a save needs, without textures or caches
+ *
+ * Only flat arrays are copied, mapped points stay shared with the file.
+ */
+inline auto save_snapshot(const SaveState &c) -> SaveState
+{
+	SaveState s;
+
+	s.cam	  = c.cam;
+	s.swls	  = c.swls;
+	s.swlis	  = c.swlis;
+	s.txwtxis = c.txwtxis;
+	s.id	  = c.id;
+	s.seq	  = c.seq;
+
+	s.swts.reserve(c.swts.size());
+	s.txwts.reserve(c.txwts.size());
+
+	for (const auto &wt : c.swts) s.swts.push_back({ .dim = wt.dim });
+	for (const auto &wt : c.txwts) s.txwts.push_back({ .dim = wt.dim });
+
+	return s;
+}
+
+/**
+ * @brief Save a snapshot of the canvas on a worker
+ *
+ * The current journal keeps recording until the file is written, then it is replaced by the journal of the saved
+ * file holding only the later changes.
+ *
+ * @param c Get the dbs to snapshot & the journal
+ * @param filename Canvas file
+ */
+inline void save_background(CanvasContext &c, const std::string &filename)
+{
+	auto &j = c.journal;
+
+	if (j.saver.joinable())
+		return;
+
+	const auto start = std::chrono::steady_clock::now();
+	auto	   s	 = save_snapshot(c);
+
+	j.snapshot_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	j.save_tick	  = SDL_GetTicks();
+	j.saving	  = journal_path(filename);
+	j.done		  = false;
+	j.saved		  = false;
+
+	j.saver = std::jthread(
+		[&j, s = std::move(s), filename]
+		{
+			const auto start = std::chrono::steady_clock::now();
+			CATCH_LOG(save(s, filename.c_str()); j.saved = true);
+
+			j.write_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			j.done	   = true;
+		});
+}
+
+/**
+ * @brief Wait for the background save and switch to the journal of the saved file
+ *
+ * @param c Get the journal
+ */
+inline void finish_save(CanvasContext &c)
+{
+	auto &j = c.journal;
+
+	j.saver.join();
+	j.done = false;
+
+	if (j.saved) // Otherwise the previous file & journal still hold everything
+		CATCH_LOG(write_journal(c, j.saving, j.tail)); // Only the changes made since the snapshot
+
+	j.saving.clear();
+	j.tail.clear();
+
+	ctl::print("Background save: snapshot %.2f ms, write %.2f ms%s\n", j.snapshot_ms, j.write_ms,
+			   j.saved ? "" : " (failed)");
+}
+
+/**
+ * @brief Wait for a background save and close the journal
+ */
+inline void close_journal(CanvasContext &c)
+{
+	auto &j = c.journal;
+
+	if (j.saver.joinable())
+		finish_save(c);
+
+	j.f.close();
+	j.path.clear();
+	j.saved = false;
+	j.lost	= false;
+}
+
+/**
+ * @brief Save the whole canvas in the background, journaling to it once written
+ *
+ * @param c Canvas to save
+ * @param filename Canvas file
+ */
+inline void save_journaled(CanvasContext &c, const char *filename)
+{
+	if (c.journal.saver.joinable()) // An autosave must not swallow an explicit save
+		finish_save(c);
+
+	if (c.id == 0) // First save since journals exist
+		c.id = std::mt19937_64(std::random_device{}())();
+
+	save_background(c, filename);
+}
+
+/**
+ * @brief Continue the journal of a loaded file, replaying its changes first
+ *
+ * Files saved before journals existed get one with their next save.
+ *
+ * @param c Loaded canvas
+ * @param filename Canvas file
+ */
+inline void open_journal(CanvasContext &c, const char *filename)
+{
+	close_journal(c);
+
+	if (c.id == 0)
+		return;
+
+	auto	  &j	= c.journal;
+	const auto path = journal_path(filename);
+	j.save_tick		= SDL_GetTicks();
+
+	if (std::filesystem::exists(path))
+	{
+		const auto d = map_file(path.c_str());
+
+		if (replay_journal(c, std::span(d->data, d->size)))
+		{
+			j.path = path;
+			j.f.open(j.path, std::ios::binary | std::ios::app);
+			j.bytes = d->size;
+
+			ctl::print("Journal: replayed up to change %ju\n", (uintmax_t)c.seq);
+			return;
+		}
+	}
+
+	write_journal(c, path, {}); // Belongs to another document
+}
+
+/**
+ * @brief Flush the journal and fold it into the file once it grew too large
+ *
+ * @param c Get the journal
+ * @param filename Canvas file
+ */
+inline void quicksave(CanvasContext &c, const std::string &filename)
+{
+	auto &j = c.journal;
+
+	if (!j.f.is_open() || j.path != journal_path(filename))
+	{
+		save_journaled(c, filename.c_str());
+		return;
+	}
+
+	j.f.flush();
+	ctl::print("Journal: %zu bytes up to change %ju\n", j.bytes, (uintmax_t)c.seq);
+
+	if (j.bytes > JOURNAL_COMPACT)
+		save_background(c, filename);
+}
+
+/**
+ * @brief Autosave a changed canvas and switch journals once a background save finished
+ *
+ * @param c Get the journal & the file to autosave to
+ */
+inline void update_journal(CanvasContext &c)
+{
+	auto &j = c.journal;
+
+	if (j.done)
+		finish_save(c);
+
+	const auto changed = j.lost || (j.f.is_open() && j.bytes > sizeof(JournalHeader));
+
+	if (changed && !c.save_path.empty() && SDL_GetTicks() - j.save_tick >= AUTOSAVE_INTERVAL)
+		save_background(c, c.save_path);
+}
@@ -1,11 +1,28 @@
 #pragma once
 
+#include <span>
+#include <array>
+#include <cmath>
+#include <deque>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <thread>
 #include <vector>
+#include <unordered_map>
+#include <condition_variable>
 
 #include <CustomLibrary/SDL/All.h>
 
 #include "renderer.h"
 #include "status.h"
+#include "mapped.h"
+#include "codec.h"
 
 using namespace ctl;
 
@@ -18,6 +35,103 @@ struct WorldLine
 	std::vector<mth::Point<float>> points;
 };
 
+static constexpr auto POINT_PRECISION = 8.F;	// Quantization steps per screen pixel at the drawing scale
+static constexpr auto POINT_RANGE	  = 16383; // Largest quantized coordinate so deltas fit 16 bits
+
+/**
+ * @brief Get the finest quantization step for a stroke drawn at a camera scale
+ */
+constexpr auto point_step(float scale) -> float
+{
+	return 1.F / (scale * POINT_PRECISION);
+}
+
+struct LinePoint
+{
+	int16_t dx, dy; // Quantized move from the previous point (from 0, 0 for the first)
+};
+
+struct LineSpan
+{
+	uint32_t offset; // First point in the shared buffer
+	uint32_t count;
+	float	 step;				   // World units per quantization step
+	bool	 mapped		   = false; // Points are in the mapped file instead of the buffer
+	bool	 packed		   = false; // Mapped points not unpacked yet, done on first read
+	uint32_t packed_offset = 0;	   // Byte offset into the packed points of the file
+};
+
+/**
+ * @brief Decoding view over the quantized points of a stroke
+ */
+struct LinePoints
+{
+	struct iterator
+	{
+		using iterator_category = std::forward_iterator_tag;
+		using value_type		= mth::Point<float>;
+		using difference_type	= std::ptrdiff_t;
+		using pointer			= void;
+		using reference			= mth::Point<float>;
+
+		const LinePoint *p;
+		int32_t			 x = 0, y = 0; // Sum of the deltas before p
+		float			 step;
+
+		auto operator*() const -> mth::Point<float>
+		{
+			return { (float)(x + p->dx) * step, (float)(y + p->dy) * step };
+		}
+
+		auto operator++() -> iterator &
+		{
+			x += p->dx;
+			y += p->dy;
+			++p;
+
+			return *this;
+		}
+
+		auto operator++(int) -> iterator
+		{
+			auto i = *this;
+			++*this;
+
+			return i;
+		}
+
+		auto operator==(const iterator &o) const -> bool
+		{
+			return p == o.p;
+		}
+	};
+
+	const LinePoint *data;
+	uint32_t		 count;
+	float			 step;
+	int32_t			 x = 0, y = 0; // Sum of the deltas before data (for views into a stroke)
+
+	auto begin() const -> iterator
+	{
+		return { .p = data, .x = x, .y = y, .step = step };
+	}
+
+	auto end() const -> iterator
+	{
+		return { .p = data + count, .step = step };
+	}
+
+	auto size() const -> size_t
+	{
+		return count;
+	}
+
+	auto empty() const -> bool
+	{
+		return count == 0;
+	}
+};
+
 struct WorldLineInfo
 {
 	float	  radius; // The radius is screen == world
@@ -28,6 +142,16 @@ struct WorldLineInfo
 struct ScreenLine
 {
 	std::vector<mth::Point<int>> points;
+	size_t						 drawn = 0; // Last point already rasterized
+};
+
+static constexpr auto STROKE_MARGIN	   = 128;  // Minimum pixels a live stroke buffer grows by
+static constexpr auto SIMPLIFY_TOLERANCE = 0.1F; // Deviation a simplified stroke may have, relative to its width
+
+struct SimplifyStats
+{
+	size_t before = 0; // Points of the simplified strokes
+	size_t after  = 0; // Points left of them
 };
 
 struct ScreenLineInfo
@@ -42,10 +166,57 @@ struct ScreenLineInfo
 // Textures
 // -----------------------------------------------------------------------------
 
+static constexpr auto ATLAS_SIZE	   = 2048; // Pixel size of an atlas page
+static constexpr auto ATLAS_ITEM_MAX = 256;  // Largest side of a texture packed into the atlas
+static constexpr auto ATLAS_OCCUPANCY = 0.25F; // Live share of a page below which it is merged into others
+static constexpr auto ATLAS_PAGE_BYTES = (int64_t)ATLAS_SIZE * ATLAS_SIZE * 4; // Held while any region is live
+
+struct AtlasRegion
+{
+	int			   page = -1; // Atlas page or -1 when not packed
+	mth::Rect<int> rect;
+};
+
+struct AtlasShelf
+{
+	int y, h;
+	int x; // Next free x
+};
+
+struct AtlasPage
+{
+	Renderer::Texture		data;
+	std::vector<AtlasShelf> shelves;
+
+	int64_t used  = 0; // Packed pixels
+	int64_t freed = 0; // Pixels released but not reusable until compaction
+};
+
+struct TextureAtlas
+{
+	std::vector<AtlasPage> pages;
+	std::vector<size_t>	   pending; // Textures generated since the last pack
+
+	void clear()
+	{
+		pages.clear();
+		pending.clear();
+	}
+};
+
+static constexpr auto STROKE_TEXTURE_MAX = 2048; // Largest side of a stroke texture in pixels
+static constexpr auto LOD_SETTLE		 = 250;	 // Milliseconds after zooming until strokes are rerasterized
+static constexpr auto LOD_BUDGET		 = 32;	 // Strokes rerasterized per frame
+
 struct WorldTexture
 {
 	mth::Rect<float>  dim;
 	Renderer::Texture data;
+	float			  res = 0.F; // Camera scale the data was rasterized at
+
+	AtlasRegion region; // Used when data was packed into the atlas
+	uint64_t	job	 = 0; // Ticket of the pending background regeneration
+	uint64_t	used = 0; // Residency frame the texture was last needed in
 };
 
 struct ScreenTexture
@@ -54,19 +225,126 @@ struct ScreenTexture
 	Renderer::CacheTexture data;
 };
 
+static constexpr auto MESH_ROUND = 12; // Triangles per round cap/join
+
+struct WorldMesh
+{
+	std::vector<mth::Point<float>> vertices; // Relative to the stroke position, empty until built
+	std::vector<int>			   indices;
+	int							   level = 0; // Detail level it was tessellated from
+};
+
+// -----------------------------------------------------------------------------
+// Tiles
+// -----------------------------------------------------------------------------
+
+static constexpr auto TILE_SIZE		 = 256; // Pixel size of a tile
+static constexpr auto TILE_CACHE_MAX = 256; // Tiles kept alive when unused
+static constexpr auto TILE_FALLBACK	 = 3;	// Coarser levels searched for a stand-in while a tile rasterizes
+static constexpr auto TILE_SETTLE	 = 150; // Milliseconds after dragging strokes until their tiles are queued again
+
+struct Tile
+{
+	int					level; // Zoom level as power of 2
+	mth::Point<int32_t> pos;   // Position in tile units of its level
+	uint64_t			used;  // Frame the tile was last drawn in
+
+	Renderer::CacheTexture data;	// nullptr when nothing is inside or still rasterizing
+	uint64_t			   job = 0; // Ticket of the pending background rasterization
+};
+
+struct TileCache
+{
+	std::unordered_map<uint64_t, Tile> tiles;
+	uint64_t							frame = 0;
+
+	uint32_t drag_tick = 0;		// Last time dragging strokes invalidated tiles
+	bool	 held	   = false; // Missing tiles were skipped while dragging
+
+	void clear()
+	{
+		tiles.clear();
+	}
+};
+
+enum class StrokeRender
+{
+	TILED,
+	TEXTURE,
+	VECTOR,
+};
+
+static constexpr auto STROKE_RENDERS = (int)StrokeRender::VECTOR + 1; // Render paths to cycle through
+
 // -----------------------------------------------------------------------------
 // Text
 // -----------------------------------------------------------------------------
 
+struct TextBuffer
+{
+	std::vector<char> data;		   // Utf-8 with a gap at the cursor
+	size_t			  gap	  = 0; // Cursor, first byte of the gap
+	size_t			  gap_end = 0; // First byte after the gap
+};
+
 struct WorldTextInfo
 {
-	std::string str;
-	float		scale;
+	TextBuffer text;
+	float	   scale;
 };
 
+static constexpr auto FONT_PATH = "res/arial.ttf";
+static constexpr auto FONT_SIZE = 30;
+static constexpr auto TEXT_WRAP = 600; // Line width in font pixels before wrapping
+
+static constexpr auto SDF_SIZE		= 64; // Font size the distance fields are generated at
+static constexpr auto SDF_SPREAD	= 4;  // Distance field range in pixels on each side of the outline
+static constexpr auto SDF_STEPS_MAX = 5;  // Most doublings of the edge sharpness (8 bit layer precision)
+static constexpr auto SDF_RATIO		= (float)FONT_SIZE / SDF_SIZE; // Font pixels per glyph pixel
+
 struct TextFont
 {
 	Renderer::Font data;
+	Renderer::Font sdf; // Opened at SDF_SIZE
+};
+
+struct Glyph
+{
+	uint32_t ch;
+
+	AtlasRegion	  region;  // Distance field padded by SDF_SPREAD
+	mth::Dim<int> size;	   // Pixels on a full line height
+	int			  advance; // Pen movement in glyph pixels
+};
+
+struct GlyphCache
+{
+	std::unordered_map<uint32_t, uint32_t> index; // Character -> glyph
+	std::vector<Glyph>					   glyphs;
+	TextureAtlas						   atlas;
+
+	int line_skip = 0;
+};
+
+struct GlyphQuad
+{
+	uint32_t			glyph;
+	mth::Point<int32_t> pos; // Glyph pixels from the paragraph top left
+};
+
+struct TextParagraph
+{
+	size_t bytes = 0; // Length without the line break
+	int	   lines = 1;
+	int	   width = 0;
+
+	std::vector<GlyphQuad> quads;
+};
+
+struct TextLayout
+{
+	std::vector<TextParagraph> paras; // One per line break
+	mth::Dim<int>			   size;  // Glyph pixels
 };
 
 // -----------------------------------------------------------------------------
@@ -82,9 +360,231 @@ enum class CanvasType
 
 struct Select
 {
-	size_t		  idx  = -1;
-	WorldTexture *wt   = nullptr;
-	CanvasType	  type = CanvasType::NONE;
+	size_t		  idx	= -1;
+	WorldTexture *wt	= nullptr;
+	CanvasType	  type	= CanvasType::NONE;
+	bool		  moved = false; // Dragged since the mouse went down
+};
+
+// -----------------------------------------------------------------------------
+// Regeneration
+// -----------------------------------------------------------------------------
+
+static constexpr auto REGEN_UPLOADS = 64; // Textures uploaded per frame
+
+struct RegenJob
+{
+	uint64_t ticket;
+	size_t	 idx; // Index when queued, might have moved since
+
+	mth::Rect<float> dim;
+	float			 res; // Scale to rasterize at
+
+	WorldLine	  wl;
+	WorldLineInfo wli;
+};
+
+struct RegenResult
+{
+	uint64_t ticket;
+	size_t	 idx;
+	float	 res;
+
+	Renderer::Image img;
+};
+
+struct TileStroke
+{
+	SDL_Color					 color;
+	float						 width;
+	std::vector<mth::Point<int>> points; // Tile pixels
+};
+
+struct TileJob
+{
+	uint64_t ticket;
+	uint64_t key; // Tile the strokes belong to
+
+	std::vector<TileStroke> strokes;
+};
+
+struct TileResult
+{
+	uint64_t ticket;
+	uint64_t key;
+
+	Renderer::Image img;
+};
+
+struct RegenPool
+{
+	std::mutex					m;
+	std::condition_variable_any cv;
+
+	std::deque<RegenJob>	 jobs;
+	std::vector<RegenResult> done;
+
+	std::deque<TileJob>		tile_jobs; // Taken before strokes, they fill the screen
+	std::vector<TileResult> tiles_done;
+
+	uint64_t next_ticket = 1;
+
+	std::vector<std::jthread> workers; // Destroyed first to join before the rest
+};
+
+// -----------------------------------------------------------------------------
+// Residency
+// -----------------------------------------------------------------------------
+
+static constexpr int64_t TEXTURE_BUDGET		= 256LL << 20; // Bytes of stroke textures, meshes & levels kept resident
+static constexpr auto	 RESIDENCY_INTERVAL = 30;		   // Frames between budget checks
+static constexpr auto	 PREFETCH_PAN		= 500;		   // Milliseconds a pan direction is prefetched for
+
+struct TextureResidency
+{
+	int64_t	 budget = TEXTURE_BUDGET;
+	int64_t	 bytes	= 0; // Resident bytes at the last check
+	uint64_t frame	= 0;
+
+	mth::Point<float> pan	   = { 0.F, 0.F }; // Last camera movement in world units
+	uint32_t		  pan_tick = 0;
+};
+
+// -----------------------------------------------------------------------------
+// Spatial
+// -----------------------------------------------------------------------------
+
+static constexpr auto GRID_CELL = 256.F; // World size of a grid cell
+
+struct SpatialGrid
+{
+	std::unordered_map<uint64_t, std::vector<size_t>> cells; // Cell key -> indices overlapping it
+
+	void clear()
+	{
+		cells.clear();
+	}
+};
+
+// -----------------------------------------------------------------------------
+// File
+// -----------------------------------------------------------------------------
+
+static constexpr std::array<char, 4> FILE_MAGIC	  = { 'C', 'N', 'V', 'S' };
+static constexpr uint32_t			 FILE_VERSION = 2;
+static constexpr size_t				 FILE_ALIGN	  = 8; // Chunks start aligned to this
+
+enum class ChunkType : uint32_t
+{
+	CAMERA = 1,
+	STROKES,   // StrokeRecord array
+	POINTS,		   // LinePoint array the strokes point into (version 1)
+	TEXTS,		   // TextRecord array
+	TEXT_DATA,	   // Utf8 bytes the texts point into
+	DOCUMENT,	   // DocumentRecord
+	PACKED_POINTS, // Zigzag varint moves the strokes point into
+};
+
+struct FileHeader
+{
+	std::array<char, 4> magic;
+	uint32_t			version;
+};
+
+struct ChunkHeader
+{
+	ChunkType type;
+	uint32_t  size; // Payload bytes, without the padding
+};
+
+struct CameraRecord
+{
+	float x, y, scale;
+	float pad = 0.F;
+};
+
+struct StrokeRecord
+{
+	float	 x, y, w, h;
+	float	 radius, scale, step;
+	uint32_t color;
+	uint32_t offset, count; // Byte offset into the packed points (index into the points for version 1) & points
+};
+
+struct TextRecord
+{
+	float	 x, y, scale;
+	uint32_t offset, size; // Bytes in the text data chunk
+	uint32_t pad = 0;
+};
+
+struct DocumentRecord
+{
+	uint64_t id, seq;
+};
+
+// -----------------------------------------------------------------------------
+// Journal
+// -----------------------------------------------------------------------------
+
+static constexpr std::array<char, 4> JOURNAL_MAGIC	  = { 'C', 'N', 'V', 'J' };
+static constexpr size_t				 JOURNAL_COMPACT = 16 << 20; // Journal bytes that start a background save
+static constexpr uint32_t			 AUTOSAVE_INTERVAL = 60000;	 // Ms between background saves of a changed canvas
+
+enum class JournalOp : uint32_t
+{
+	ADD_STROKE = 1, // StrokeRecord, then the LinePoints
+	ERASE_STROKE,	// uint32_t index
+	MOVE,			// MoveRecord
+	ADD_TEXT,		// TextRecord, then the bytes
+	EDIT_TEXT,		// EditRecord, then the inserted bytes
+	ERASE_TEXT,		// uint32_t index
+};
+
+struct JournalHeader
+{
+	std::array<char, 4> magic;
+	uint32_t			version;
+	uint64_t			id; // Document the changes apply to
+};
+
+struct OpHeader
+{
+	JournalOp op;
+	uint32_t  size; // Payload bytes
+	uint64_t  seq;
+};
+
+struct MoveRecord
+{
+	CanvasType type;
+	uint32_t   idx;
+	float	   x, y;
+};
+
+struct EditRecord
+{
+	uint32_t idx;
+	uint32_t pos;	// Cursor before the edit
+	uint32_t erase; // Bytes removed before the cursor
+	uint32_t size;	// Bytes inserted
+};
+
+struct Journal
+{
+	std::string	  path; // Empty until the canvas is saved or a journaled file is loaded
+	std::ofstream f;
+	size_t		  bytes = 0;
+
+	std::string		  saving;			 // Journal of the file being saved, taken over once it is written
+	std::string		  tail;				 // Changes made while saving in the background
+	std::atomic<bool> done		  = false; // Set by the worker when finished
+	std::atomic<bool> saved		  = false; // The canvas file holds every change before the tail
+	bool			  lost		  = false; // A change could not be journaled, saved with the whole canvas
+	uint32_t		  save_tick	  = 0;	   // Time of the last background save
+	float			  snapshot_ms = 0.F;   // Spent copying on the event thread
+	float			  write_ms	  = 0.F;   // Spent serializing & writing on the worker
+	std::jthread	  saver;			   // Last, so it is joined first
 };
 
 // -----------------------------------------------------------------------------
@@ -103,15 +603,215 @@ struct CanvasDebug
 
 using WorldTextureDB = std::vector<WorldTexture>;
 
-using WorldLineDB	  = std::vector<WorldLine>;
+/**
+ * @brief Quantized points of all strokes back to back in one buffer
+ *
+ * Elements are the spans of the strokes so the quick erase only moves spans; the points of erased strokes stay
+ * until compacted.
+ */
+struct WorldLineDB
+{
+	std::vector<LinePoint> pts;
+	std::vector<LineSpan>  lines;
+
+	size_t dead = 0; // Points no stroke refers to anymore
+
+	std::shared_ptr<const MappedFile> file;				// Loaded file the mapped lines are in
+	const LinePoint					 *mapped = nullptr; // Points chunk of the file or the points unpacked from it
+	std::shared_ptr<LinePoint[]>	  unpacked;			// Filled a stroke at a time, untouched pages stay unallocated
+	std::span<const char>			  packed;			// Packed points chunk of the file
+
+	auto size() const
+	{
+		return lines.size();
+	}
+
+	auto empty() const
+	{
+		return lines.empty();
+	}
+
+	auto operator[](size_t i) -> LineSpan &
+	{
+		return lines[i];
+	}
+
+	auto back() -> LineSpan &
+	{
+		return lines.back();
+	}
+
+	auto end()
+	{
+		return lines.end();
+	}
+
+	void erase(std::vector<LineSpan>::iterator i)
+	{
+		if (!i->mapped)
+			dead += i->count;
+
+		lines.erase(i);
+	}
+
+	void clear()
+	{
+		pts.clear();
+		lines.clear();
+		dead = 0;
+
+		file.reset();
+		mapped = nullptr;
+		unpacked.reset();
+		packed = {};
+	}
+
+	/**
+	 * @brief Decode the points of a stroke still packed in the file (validated on load)
+	 *
+	 * Only called on the owning thread, as it writes the shared buffer.
+	 */
+	void unpack(size_t i)
+	{
+		auto &l = lines[i];
+
+		if (!l.packed)
+			return;
+
+		size_t pos = l.packed_offset;
+		unpack_points(packed, pos, std::span(unpacked.get() + l.offset, l.count));
+
+		l.packed = false;
+	}
+
+	/**
+	 * @brief Get the decoded points of a stroke, unpacking them on first read
+	 */
+	auto points(size_t i) -> LinePoints
+	{
+		unpack(i);
+		return std::as_const(*this).points(i);
+	}
+
+	/**
+	 * @brief Get the decoded points of an unpacked stroke
+	 */
+	auto points(size_t i) const -> LinePoints
+	{
+		const auto &l = lines[i];
+		assert(!l.packed && "Points of a stroke read before unpacking.");
+
+		const auto *d = l.mapped ? mapped : pts.data();
+		return { .data = d + l.offset, .count = l.count, .step = l.step };
+	}
+
+	/**
+	 * @brief Append the packed moves of a stroke, copied from the file if never unpacked
+	 *
+	 * Safe on copies used by other threads, as it does not unpack.
+	 */
+	void pack(size_t i, std::string &out) const
+	{
+		const auto &l = lines[i];
+
+		if (l.packed)
+		{
+			size_t pos = l.packed_offset;
+			skip_points(packed, pos, l.count);
+
+			out.append(packed.data() + l.packed_offset, pos - l.packed_offset);
+		}
+		else
+		{
+			const auto *d = l.mapped ? mapped : pts.data();
+			pack_points(std::span(d + l.offset, l.count), out);
+		}
+	}
+
+	/**
+	 * @brief Unpack & append a stroke
+	 *
+	 * @param d Packed bytes
+	 * @param pos Position of the stroke, moved past it
+	 * @param count Points of the stroke
+	 * @param step World units per quantization step
+	 */
+	void push_packed(std::span<const char> d, size_t &pos, uint32_t count, float step)
+	{
+		if (count > (d.size() - pos) / 2) // Each point takes at least 2 bytes
+			throw std::runtime_error("Packed points are cut off.");
+
+		const auto o = pts.size();
+		pts.resize(o + count);
+		unpack_points(d, pos, std::span(pts).subspan(o));
+
+		lines.push_back({ .offset = (uint32_t)o, .count = count, .step = step });
+	}
+
+	/**
+	 * @brief Quantize & append a stroke
+	 *
+	 * @param ps Points relative to the stroke position
+	 * @param step Finest world units per quantization step, coarser if the stroke is too large
+	 */
+	template<typename Range>
+	void push_back(const Range &ps, float step)
+	{
+		float m = 0.F;
+		for (const auto &p : ps) m = std::max({ m, std::abs(p.x), std::abs(p.y) });
+
+		step = std::max(step, m / POINT_RANGE);
+
+		lines.push_back({ .offset = (uint32_t)pts.size(), .count = (uint32_t)std::size(ps), .step = step });
+
+		int32_t px = 0, py = 0;
+
+		for (const auto &p : ps)
+		{
+			const auto x = (int32_t)std::lround(p.x / step);
+			const auto y = (int32_t)std::lround(p.y / step);
+
+			pts.push_back({ (int16_t)(x - px), (int16_t)(y - py) });
+
+			px = x;
+			py = y;
+		}
+	}
+};
+
+static constexpr auto LOD_LEVELS	= 4;	// Simplified levels kept per stroke, each for half the scale
+static constexpr auto LOD_TOLERANCE = 0.5F; // Screen pixels a level may deviate by at its scale
+
+static constexpr auto SEGMENT_CHUNK = 64; // Segments per bounded chunk of a long stroke
+
+struct LineChunk
+{
+	mth::Rect<float> area;	// Covered by the segments of the chunk
+	uint32_t		 first; // First point
+	int32_t			 x, y;	// Sum of the deltas before the first point
+};
+
+struct LineBounds
+{
+	int					   level = -1; // Detail level the chunks were built for
+	std::vector<LineChunk> chunks;
+};
+
 using WorldLineInfoDB = std::vector<WorldLineInfo>;
+using WorldLodDB	  = std::vector<WorldLineDB>; // Levels 1.. of each line, empty until built
+using LineBoundsDB	  = std::vector<LineBounds>;  // Chunks of the long lines, built when erasing
+using WorldMeshDB	  = std::vector<WorldMesh>;
 
 using WorldTextInfoDB = std::vector<WorldTextInfo>;
+using TextLayoutDB	  = std::vector<TextLayout>;
 
 // -----------------------------------------------------------------------------
 // Context
 // -----------------------------------------------------------------------------
 
+static constexpr auto ZOOM_MIN = 0.1F; // Camera scale limits
+static constexpr auto ZOOM_MAX = 10.F;
+
 struct SaveState
 {
 	CanvasStatus status = CanvasStatus::PAINTING;
@@ -121,18 +821,41 @@ struct SaveState
 	WorldLineDB		swls;
 	WorldLineInfoDB swlis;
 	WorldTextureDB	swts;
+	WorldLodDB		swlods;
+	LineBoundsDB	swbs;
+	WorldMeshDB		swms;
+	SpatialGrid		swg;
 
-	WorldTextureDB	txwts;
+	WorldTextureDB	txwts; // Only the dimensions, drawn from the glyph cache
 	WorldTextInfoDB txwtxis;
+	TextLayoutDB	txls;
+	SpatialGrid		txwg;
+
+	uint64_t id	 = 0; // Identifies the canvas to its journal
+	uint64_t seq = 0; // Last journaled change
 };
 
 struct CanvasContext : SaveState
 {
-	ScreenLine	   ssl;
-	ScreenLineInfo ssli;
-	ScreenTexture  sst;
+	ScreenLine			   ssl;
+	ScreenLineInfo		   ssli;
+	ScreenTexture		   sst;
+	Renderer::StrokeBuffer ssb;
+
+	StrokeRender stroke_render = StrokeRender::TILED;
+	TileCache	 tiles;
+	TextureAtlas atlas;
+	RegenPool	 regen;
+
+	TextureResidency residency;
+	SimplifyStats	 simplify;
+	Journal			 journal;
 
-	TextFont txf;
+	uint32_t zoom_tick = 0;		// Time of the last zoom
+	bool	 lod_dirty = false; // Visible strokes might have the wrong resolution
+
+	TextFont   txf;
+	GlyphCache glyphs;
 
 	Select select;
 
@@ -169,6 +892,21 @@ inline void erase(size_t i, U &arr, T &...arrs)
 	(arrs.erase(arrs.end() - 1), ...);
 }
 
+/**
+ * @brief Get the area spanned by points
+ *
+ * @param ps Points to include
+ *
+ * @return Bounding rectangle
+ */
+inline auto bounding_rect(std::initializer_list<mth::Point<int>> ps) -> mth::Rect<int>
+{
+	const auto [x1, x2] = std::minmax_element(ps.begin(), ps.end(), [](auto a, auto b) { return a.x < b.x; });
+	const auto [y1, y2] = std::minmax_element(ps.begin(), ps.end(), [](auto a, auto b) { return a.y < b.y; });
+
+	return { x1->x, y1->y, x2->x - x1->x, y2->y - y1->y };
+}
+
 /**
  * @brief Clear vectors
  *
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <vector>
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/**
+ * @brief Read-only file contents paged in by the os as they are touched
+ */
+struct MappedFile
+{
+	const char *data = nullptr;
+	size_t		size = 0;
+
+#ifdef _WIN32
+	std::vector<char> buf; // Read at once, mapped files could not be replaced when saving
+#endif
+
+	MappedFile()					= default;
+	MappedFile(const MappedFile &) = delete;
+	auto operator=(const MappedFile &) -> MappedFile & = delete;
+
+	~MappedFile()
+	{
+#ifndef _WIN32
+		if (data != nullptr)
+			munmap((void *)data, size);
+#endif
+	}
+};
+
+/**
+ * @brief Map a whole file
+ *
+ * @param filename File to map
+ *
+ * @return Mapping shared by everything reading from it
+ */
+inline auto map_file(const char *filename) -> std::shared_ptr<const MappedFile>
+{
+	auto m = std::make_shared<MappedFile>();
+
+#ifdef _WIN32
+	std::ifstream f(filename, std::ios::binary | std::ios::ate);
+
+	if (!f)
+		throw std::runtime_error("Could not open the file.");
+
+	m->buf.resize((size_t)f.tellg());
+	f.seekg(0);
+
+	if (!f.read(m->buf.data(), (std::streamsize)m->buf.size()))
+		throw std::runtime_error("Could not read the file.");
+
+	m->data = m->buf.data();
+	m->size = m->buf.size();
+#else
+	const auto fd = open(filename, O_RDONLY);
+
+	if (fd == -1)
+		throw std::runtime_error("Could not open the file.");
+
+	struct stat st;
+	fstat(fd, &st);
+
+	if (st.st_size != 0)
+	{
+		auto *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (p == MAP_FAILED)
+		{
+			close(fd);
+			throw std::runtime_error("Could not map the file.");
+		}
+
+		m->data = (const char *)p;
+		m->size = (size_t)st.st_size;
+	}
+
+	close(fd); // The mapping stays valid
+#endif
+
+	return m;
+}
+
+/**
+ * @brief Wait until a written file reached the disk
+ *
+ * @param filename Closed file to sync
+ */
+inline void sync_file(const char *filename)
+{
+#ifdef _WIN32
+	const auto fd = _open(filename, _O_RDWR | _O_BINARY);
+
+	if (fd == -1 || _commit(fd) != 0)
+	{
+		if (fd != -1)
+			_close(fd);
+
+		throw std::runtime_error("Could not sync the file.");
+	}
+
+	_close(fd);
+#else
+	const auto fd = open(filename, O_RDONLY);
+
+	if (fd == -1 || fsync(fd) != 0)
+	{
+		if (fd != -1)
+			close(fd);
+
+		throw std::runtime_error("Could not sync the file.");
+	}
+
+	close(fd);
+#endif
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cmath>
+#include <numbers>
+#include <optional>
+
+#include "layout.h"
+#include "spatial.h"
+#include "stroke.h"
+#include "transform.h"
+
+using namespace ctl;
+
+/**
+ * @brief Add a filled circle to a mesh
+ *
+ * @param m Mesh to extend
+ * @param p Center
+ * @param r Radius
+ */
+inline void mesh_circle(WorldMesh &m, mth::Point<float> p, float r)
+{
+	const auto c = (int)m.vertices.size();
+	m.vertices.push_back(p);
+
+	for (int i = 0; i < MESH_ROUND; ++i)
+	{
+		const auto a = 2.F * std::numbers::pi_v<float> * i / MESH_ROUND;
+		m.vertices.push_back({ p.x + r * std::cos(a), p.y + r * std::sin(a) });
+
+		m.indices.insert(m.indices.end(), { c, c + 1 + i, c + 1 + (i + 1) % MESH_ROUND });
+	}
+}
+
+/**
+ * @brief Add a thick segment to a mesh
+ *
+ * @param m Mesh to extend
+ * @param a Segment start
+ * @param b Segment end
+ * @param r Half of the thickness
+ */
+inline void mesh_segment(WorldMesh &m, mth::Point<float> a, mth::Point<float> b, float r)
+{
+	const auto dx  = b.x - a.x;
+	const auto dy  = b.y - a.y;
+	const auto len = std::sqrt(dx * dx + dy * dy);
+
+	if (len == 0.F)
+		return;
+
+	const mth::Point<float> n = { -dy / len * r, dx / len * r };
+	const auto				c = (int)m.vertices.size();
+
+	m.vertices.insert(m.vertices.end(), { a + n, b + n, b - n, a - n });
+	m.indices.insert(m.indices.end(), { c, c + 1, c + 2, c, c + 2, c + 3 });
+}
+
+/**
+ * @brief Tessellate a stroke into triangles with round caps and joins
+ *
+ * @param ps Points to tessellate
+ * @param wli Stroke width
+ *
+ * @return Mesh relative to the stroke position
+ */
+inline auto tessellate_stroke(const LinePoints &ps, const WorldLineInfo &wli) -> WorldMesh
+{
+	WorldMesh  m;
+	const auto r = wli.radius / wli.scale / 2.F; // Radius is the cairo line width
+
+	std::optional<mth::Point<float>> prev;
+
+	for (const auto p : ps)
+	{
+		mesh_circle(m, p, r);
+
+		if (prev)
+			mesh_segment(m, *prev, p, r);
+
+		prev = p;
+	}
+
+	return m;
+}
+
+/**
+ * @brief Draw the visible strokes as triangles under the camera
+ *
+ * @param r Draw the batch
+ * @param c Get the strokes and their meshes (built on demand)
+ */
+inline void draw_meshes(const Renderer &r, CanvasContext &c)
+{
+	std::vector<mth::Point<float>> vs;
+	std::vector<SDL_Color>		   cols;
+	std::vector<int>			   is;
+
+	for (size_t i : grid_query(c.swg, c.swts, visible_area(r, c.cam)))
+	{
+		auto	  &m	 = c.swms[i];
+		const auto level = lod_level(c.swlis[i], c.cam.scale);
+
+		if (m.vertices.empty() || m.level != level)
+		{
+			m		= tessellate_stroke(lod_points(c.swlods, c.swls, c.swlis, i, c.cam.scale), c.swlis[i]);
+			m.level = level;
+		}
+
+		const auto pos = c.swts[i].dim.pos();
+		const auto b   = (int)vs.size();
+
+		vs.resize(b + m.vertices.size());
+		world_screen_batch(c.cam, m.vertices, std::span(vs).subspan(b), pos);
+		cols.resize(vs.size(), c.swlis[i].color);
+
+		for (const auto idx : m.indices) is.push_back(b + idx);
+	}
+
+	if (!is.empty())
+		r.draw_mesh(vs, cols, is);
+}
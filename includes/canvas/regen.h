@@ -0,0 +1,228 @@
+#pragma once
+
+#include <span>
+#include <thread>
+#include <algorithm>
+
+#include "layout.h"
+#include "spatial.h"
+#include "stroke.h"
+#include "atlas.h"
+
+using namespace ctl;
+
+/**
+ * @brief Rasterize a job into cpu pixels
+ *
+ * @param j Job to process
+ *
+ * @return Result ready for upload
+ */
+inline auto regen_process(const RegenJob &j) -> RegenResult
+{
+	RegenResult res = { .ticket = j.ticket, .idx = j.idx, .res = j.res };
+
+	sdl::Camera2D cam{ .loc = { 0.F, 0.F }, .scale = j.res };
+
+	const auto d = cam.world_screen(mth::Dim<float>{ j.dim.w, j.dim.h });
+
+	std::vector<mth::Point<int>> ps_pos(j.wl.points.size());
+	world_screen_batch(cam, j.wl.points, ps_pos);
+
+	res.img = Renderer::raster_stroke({ std::max(d.w, 1), std::max(d.h, 1) }, j.wli.color,
+									  j.wli.radius / j.wli.scale * j.res, ps_pos);
+
+	return res;
+}
+
+/**
+ * @brief Rasterize the strokes of a tile into cpu pixels
+ *
+ * @param j Job to process
+ *
+ * @return Result ready for upload
+ */
+inline auto tile_process(const TileJob &j) -> TileResult
+{
+	auto img = Renderer::create_image({ TILE_SIZE, TILE_SIZE });
+
+	for (const auto &s : j.strokes) Renderer::raster_stroke(img, s.color, s.width, s.points);
+
+	return { .ticket = j.ticket, .key = j.key, .img = std::move(img) };
+}
+
+/**
+ * @brief Worker loop taking jobs until stopped
+ */
+inline void regen_work(std::stop_token st, RegenPool &p)
+{
+	while (true)
+	{
+		std::unique_lock l(p.m);
+
+		if (!p.cv.wait(l, st, [&p] { return !p.jobs.empty() || !p.tile_jobs.empty(); }))
+			return;
+
+		if (!p.tile_jobs.empty())
+		{
+			auto j = std::move(p.tile_jobs.front());
+			p.tile_jobs.pop_front();
+			l.unlock();
+
+			auto res = tile_process(j);
+
+			l.lock();
+			p.tiles_done.push_back(std::move(res));
+			continue;
+		}
+
+		auto j = std::move(p.jobs.front());
+		p.jobs.pop_front();
+		l.unlock();
+
+		auto res = regen_process(j);
+
+		l.lock();
+		p.done.push_back(std::move(res));
+	}
+}
+
+/**
+ * @brief Start the workers
+ *
+ * @param p Pool to start
+ */
+inline void init_regen(RegenPool &p)
+{
+	const auto n = std::max(std::thread::hardware_concurrency(), 2U) - 1; // Leave one for the ui
+
+	for (unsigned i = 0; i < n; ++i) p.workers.emplace_back([&p](std::stop_token st) { regen_work(st, p); });
+}
+
+/**
+ * @brief Check if a texture has to be generated
+ */
+inline auto texture_missing(const WorldTexture &wt) -> bool
+{
+	return !wt.data && wt.region.page == -1 && wt.job == 0;
+}
+
+/**
+ * @brief Queue the background generation of missing stroke textures
+ *
+ * @param p Pool to queue to
+ * @param wts Stroke textures
+ * @param wls Stroke lines
+ * @param wlis Stroke infos
+ * @param lods Simplified levels of the lines
+ * @param idx Strokes to generate if missing
+ * @param scale Camera scale to rasterize for
+ */
+inline void queue_strokes(RegenPool &p, WorldTextureDB &wts, WorldLineDB &wls, const WorldLineInfoDB &wlis,
+						  WorldLodDB &lods, std::span<const size_t> idx, float scale)
+{
+	std::lock_guard l(p.m);
+	const auto		n = p.jobs.size();
+
+	for (auto i : idx)
+	{
+		auto &wt = wts[i];
+
+		if (!texture_missing(wt))
+			continue;
+
+		wt.job = p.next_ticket++;
+
+		const auto res = stroke_lod_scale(wt.dim, scale);
+		const auto ps  = lod_points(lods, wls, wlis, i, res);
+
+		p.jobs.push_back({ .ticket = wt.job,
+						   .idx	   = i,
+						   .dim	   = wt.dim,
+						   .res	   = res,
+						   .wl	   = { .points = { ps.begin(), ps.end() } },
+						   .wli	   = wlis[i] });
+	}
+
+	if (p.jobs.size() != n)
+		p.cv.notify_all();
+}
+
+/**
+ * @brief Drop all textures and pending jobs (regenerated once they are needed)
+ *
+ * @param p Pool to cancel the jobs of
+ * @param wts Stroke textures
+ */
+inline void drop_textures(RegenPool &p, WorldTextureDB &wts)
+{
+	{
+		std::lock_guard l(p.m);
+
+		p.jobs.clear(); // Outdated jobs of a previous load
+		p.done.clear();
+	}
+
+	for (auto &wt : wts)
+	{
+		wt.data.reset();
+		wt.region = {};
+		wt.res	  = 0.F;
+		wt.job	  = 0;
+	}
+}
+
+/**
+ * @brief Find where the texture of a job went
+ *
+ * @param wts Db to search
+ * @param idx Index when queued
+ * @param ticket Ticket of the job
+ *
+ * @return Current index if it still waits for the job
+ */
+inline auto find_job(const WorldTextureDB &wts, size_t idx, uint64_t ticket) -> std::optional<size_t>
+{
+	if (idx < wts.size() && wts[idx].job == ticket)
+		return idx;
+
+	// Moved by an erase (or replaced, then not found)
+	const auto f = std::find_if(wts.begin(), wts.end(), [ticket](const WorldTexture &wt) { return wt.job == ticket; });
+	return f != wts.end() ? std::optional((size_t)std::distance(wts.begin(), f)) : std::nullopt;
+}
+
+/**
+ * @brief Upload a budgeted amount of finished jobs
+ *
+ * @param r Upload the pixels & mark damage
+ * @param c Get the dbs to fill
+ */
+inline void apply_regen(Renderer &r, CanvasContext &c)
+{
+	std::vector<RegenResult> done;
+
+	{
+		std::lock_guard l(c.regen.m);
+
+		const auto n = std::min(c.regen.done.size(), (size_t)REGEN_UPLOADS);
+		std::move(c.regen.done.end() - n, c.regen.done.end(), std::back_inserter(done));
+		c.regen.done.erase(c.regen.done.end() - n, c.regen.done.end());
+	}
+
+	for (auto &res : done)
+	{
+		const auto i = find_job(c.swts, res.idx, res.ticket);
+
+		if (!i)
+			continue;
+
+		auto &wt = c.swts[*i];
+
+		wt.data = r.create_image_texture(res.img);
+		wt.res	= res.res;
+		wt.job	= 0;
+
+		atlas_queue(c.atlas, *i);
+		r.refresh(c.cam.world_screen(wt.dim));
+	}
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <tuple>
+#include <vector>
+#include <algorithm>
+
+#include "layout.h"
+#include "spatial.h"
+#include "atlas.h"
+#include "regen.h"
+
+using namespace ctl;
+
+/**
+ * @brief Get the video memory held by a standalone texture
+ *
+ * @param r Query the texture size
+ * @param wt Texture to measure
+ *
+ * @return Bytes of the texture, 0 when packed as its atlas page is counted whole
+ */
+inline auto texture_bytes(const Renderer &r, const WorldTexture &wt) -> int64_t
+{
+	if (!wt.data)
+		return 0;
+
+	const auto s = r.get_texture_size(wt.data);
+	return (int64_t)s.w * s.h * 4;
+}
+
+/**
+ * @brief Get the memory held by the cached data of a stroke
+ *
+ * @param r Query the texture size
+ * @param wt Texture of the stroke
+ * @param lod Simplified levels of the stroke
+ * @param m Mesh of the stroke
+ *
+ * @return Bytes of the texture, levels & mesh
+ */
+inline auto stroke_bytes(const Renderer &r, const WorldTexture &wt, const WorldLineDB &lod, const WorldMesh &m)
+	-> int64_t
+{
+	const auto lb = lod.pts.capacity() * sizeof(LinePoint) + lod.lines.capacity() * sizeof(LineSpan);
+	const auto mb = m.vertices.capacity() * sizeof(mth::Point<float>) + m.indices.capacity() * sizeof(int);
+
+	return texture_bytes(r, wt) + (int64_t)(lb + mb);
+}
+
+/**
+ * @brief Get the world area worth keeping resident
+ *
+ * @param r Get the screen size
+ * @param c Get the camera and the last pan
+ *
+ * @return Visible area grown by half a screen, and a full screen towards a recent pan
+ */
+inline auto prefetch_area(const Renderer &r, const CanvasContext &c) -> mth::Rect<float>
+{
+	const auto s = r.get_output_size();
+	auto	   a = c.cam.screen_world(mth::Rect<int>{ 0, 0, s.w, s.h });
+
+	const auto mx = a.w / 2.F;
+	const auto my = a.h / 2.F;
+
+	const auto &rs	= c.residency;
+	const auto	pan = SDL_GetTicks() - rs.pan_tick < PREFETCH_PAN;
+
+	const auto l = mx + (pan && rs.pan.x < 0.F ? a.w : 0.F);
+	const auto t = my + (pan && rs.pan.y < 0.F ? a.h : 0.F);
+	const auto w = mx + (pan && rs.pan.x > 0.F ? a.w : 0.F);
+	const auto h = my + (pan && rs.pan.y > 0.F ? a.h : 0.F);
+
+	return { a.x - l, a.y - t, a.w + l + w, a.h + t + h };
+}
+
+/**
+ * @brief Mark strokes as needed this frame, with their texture, levels & mesh
+ *
+ * @param rs Residency to take the frame from
+ * @param wts Textures to mark
+ * @param idx Needed indices
+ */
+inline void touch_textures(const TextureResidency &rs, WorldTextureDB &wts, std::span<const size_t> idx)
+{
+	for (auto i : idx) wts[i].used = rs.frame;
+}
+
+/**
+ * @brief Release the cached data of strokes until the resident bytes fit the budget
+ *
+ * Packed strokes age with the most recently used region of their page, so a page is released as a whole instead of
+ * having scattered regions freed while it stays allocated.
+ *
+ * @param r Measure the textures
+ * @param rs Residency to account into
+ * @param a Atlas holding packed textures
+ * @param wts Textures to evict from
+ * @param lods Simplified levels to evict from (built again on demand)
+ * @param ms Meshes to evict from (tessellated again when drawn)
+ */
+inline void evict_strokes(const Renderer &r, TextureResidency &rs, TextureAtlas &a, WorldTextureDB &wts,
+						  WorldLodDB &lods, WorldMeshDB &ms)
+{
+	std::vector<uint64_t> page_used(a.pages.size(), 0);
+
+	for (const auto &wt : wts)
+		if (wt.region.page != -1)
+			page_used[wt.region.page] = std::max(page_used[wt.region.page], wt.used);
+
+	std::vector<std::tuple<uint64_t, int, size_t>> old; // Candidates by last use, grouped by page
+
+	rs.bytes = atlas_bytes(a);
+
+	for (size_t i = 0; i < wts.size(); ++i)
+	{
+		const auto page = wts[i].region.page;
+		const auto used = page == -1 ? wts[i].used : page_used[page];
+		const auto b	= stroke_bytes(r, wts[i], lods[i], ms[i]);
+
+		rs.bytes += b;
+
+		if ((b != 0 || page != -1) && used != rs.frame)
+			old.emplace_back(used, page, i);
+	}
+
+	if (rs.bytes <= rs.budget)
+		return;
+
+	std::sort(old.begin(), old.end());
+
+	const auto target = rs.budget / 10 * 9; // Leave room to not evict again right away
+
+	for (auto [_, page, i] : old)
+	{
+		if (rs.bytes <= target)
+			break;
+
+		auto &wt = wts[i];
+		rs.bytes -= stroke_bytes(r, wt, lods[i], ms[i]);
+
+		wt.data.reset();
+		atlas_free(a, wt.region);
+		wt.res = 0.F; // Rasterized again once needed
+
+		if (page != -1 && !a.pages[page].data) // Its last region
+			rs.bytes -= ATLAS_PAGE_BYTES;
+
+		lods[i] = {};
+		ms[i]	= {};
+	}
+}
+
+/**
+ * @brief Keep the strokes around the view resident and the rest within budget
+ *
+ * @param r Get the view & measure textures
+ * @param c Get the dbs, atlas & workers
+ */
+inline void update_residency(Renderer &r, CanvasContext &c)
+{
+	auto &rs = c.residency;
+	++rs.frame;
+
+	const auto sts = grid_query(c.swg, c.swts, prefetch_area(r, c));
+	touch_textures(rs, c.swts, sts);
+
+	if (c.stroke_render == StrokeRender::TEXTURE) // Other paths don't read the stroke textures
+		queue_strokes(c.regen, c.swts, c.swls, c.swlis, c.swlods, sts, c.cam.scale);
+
+	if (rs.frame % RESIDENCY_INTERVAL != 0)
+		return;
+
+	evict_strokes(r, rs, c.atlas, c.swts, c.swlods, c.swms);
+}
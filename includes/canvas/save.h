@@ -1,104 +1,158 @@
 #pragma once
 
+#include <span>
 #include <array>
+#include <tuple>
+#include <vector>
+#include <fstream>
 #include <optional>
+#include <filesystem>
+#include <string_view>
 
 #include <CustomLibrary/IO.h>
-#include <CustomLibrary/utility.h>
 
 #include "layout.h"
+#include "text_buffer.h"
+#include "binary.h"
+#include "xml.h"
 #include "event.h"
 #include "window.h"
-#include "pugixml.hpp"
 
 // -----------------------------------------------------------------------------
 // Saving
 // -----------------------------------------------------------------------------
 
 /**
- * @brief Save the stroke component to the xml doc
+ * @brief Write the stroke component
  *
  * @param c Get the stroke items
- * @param node Location to store the xml data
+ * @param w Writer inside the doc element
  */
-inline void save_strokes(const CanvasContext &c, pugi::xml_node &node)
+inline void save_strokes(const SaveState &c, XmlWriter &w)
 {
-	auto lines = node.append_child("line");
+	xml_begin(w, 1, "line");
+	xml_begin_end(w, c.swts.empty());
+
+	std::string packed, text; // Reused for every stroke
 
 	for (size_t i = 0; i < c.swts.size(); ++i)
 	{
 		const auto &t  = c.swts[i];
-		const auto &l  = c.swls[i];
+		const auto &l  = c.swls.lines[i]; // Not unpacked, this runs on copies in the background
 		const auto &li = c.swlis[i];
 
-		auto ln = lines.append_child("l");
+		xml_begin(w, 2, "l");
 
-		ln.append_attribute("r") = li.radius;
-		ln.append_attribute("c") = *(uint32_t *)&li.color;
-		ln.append_attribute("s") = li.scale;
+		xml_attribute(w, "r", li.radius);
+		xml_attribute(w, "c", *(uint32_t *)&li.color);
+		xml_attribute(w, "s", li.scale);
 
-		ln.append_attribute("x") = t.dim.x;
-		ln.append_attribute("y") = t.dim.y;
-		ln.append_attribute("w") = t.dim.w;
-		ln.append_attribute("h") = t.dim.h;
+		xml_attribute(w, "x", t.dim.x);
+		xml_attribute(w, "y", t.dim.y);
+		xml_attribute(w, "w", t.dim.w);
+		xml_attribute(w, "h", t.dim.h);
 
-		for (const auto &l : l.points)
-		{
-			auto subnode = ln.append_child("p");
+		xml_attribute(w, "q", l.step);
+		xml_attribute(w, "n", l.count);
 
-			subnode.append_attribute("x") = l.x;
-			subnode.append_attribute("y") = l.y;
-		}
+		packed.clear();
+		text.clear();
+		c.swls.pack(i, packed);
+		base64_encode(packed, text);
+
+		xml_attribute(w, "p", std::string_view(text));
+		xml_begin_end(w, true);
 	}
+
+	if (!c.swts.empty())
+		xml_end(w, 1, "line");
 }
 
 /**
- * @brief Save the text component to the xml doc
+ * @brief Write the text component
  *
  * @param c Get the text info for storage
- * @param node Xml document node to store to
+ * @param w Writer inside the doc element
  */
-inline auto save_text(const CanvasContext &c, pugi::xml_node &node)
+inline void save_text(const SaveState &c, XmlWriter &w)
 {
-	auto texts = node.append_child("text");
+	xml_begin(w, 1, "text");
+	xml_begin_end(w, c.txwts.empty());
 
 	for (size_t i = 0; i < c.txwts.size(); ++i)
 	{
 		const auto &t	= c.txwts[i];
 		const auto &txi = c.txwtxis[i];
 
-		auto ln = texts.append_child("t");
+		xml_begin(w, 2, "t");
 
-		ln.append_attribute("s") = txi.scale;
-		ln.append_attribute("t") = txi.str.c_str();
+		xml_attribute(w, "s", txi.scale);
+		xml_attribute(w, "t", std::string_view(text_string(txi.text)));
 
-		ln.append_attribute("x") = t.dim.x;
-		ln.append_attribute("y") = t.dim.y;
+		xml_attribute(w, "x", t.dim.x);
+		xml_attribute(w, "y", t.dim.y);
+
+		xml_begin_end(w, true);
 	}
+
+	if (!c.txwts.empty())
+		xml_end(w, 1, "text");
 }
 
 /**
- * @brief Save the canvas into save.xml using XML
- * <doc>
- *     <ls rad= col= s= x= y= w= h= >
- *         <l x= y= > ...
- *     </ls> ...
+ * @brief Save the canvas using XML (for interchange), streamed through a fixed buffer
+ * Points are packed and stored as base64 in p, with their quantization step in q and count in n
+ * <doc id= seq= >
+ *     <line>
+ *         <l r= c= s= x= y= w= h= q= n= p= /> ...
+ *     </line>
+ *     <text>
+ *         <t s= t= x= y= /> ...
+ *     </text>
  * </doc>
  *
  * @param c Get lines info and texture dimensions
  */
-inline void save(const CanvasContext &c, const char *filename)
+inline void save_xml(const SaveState &c, const char *filename)
 {
 	static_assert(sizeof(SDL_Color) == 4, "SDL_Color must be 4 bytes long.");
 
-	pugi::xml_document doc;
+	auto w = xml_writer(filename);
+
+	xml_begin(w, 0, "doc");
+	xml_attribute(w, "id", c.id);
+	xml_attribute(w, "seq", c.seq);
+	xml_begin_end(w, false);
+
+	save_strokes(c, w);
+	save_text(c, w);
 
-	auto node = doc.append_child("doc");
+	xml_end(w, 0, "doc");
+	w.buf += '\n';
+
+	xml_flush(w);
+}
+
+/**
+ * @brief Save the canvas, as XML for .xml files and as binary chunks otherwise
+ *
+ * Written & synced next to the file and moved over it, so a crash leaves either version and mapped points stay valid.
+ *
+ * @param c Get the canvas to store
+ * @param filename File to write
+ */
+inline void save(const SaveState &c, const char *filename)
+{
+	const auto xml = std::string_view(filename).ends_with(".xml");
+	const auto tmp = std::string(filename) + ".tmp";
 
-	save_strokes(c, node);
-	save_text(c, node);
+	if (xml)
+		save_xml(c, tmp.c_str());
+	else
+		save_binary(c, tmp.c_str());
 
-	doc.save_file(filename);
+	sync_file(tmp.c_str());
+	std::filesystem::rename(tmp, filename);
 }
 
 // -----------------------------------------------------------------------------
@@ -106,113 +160,188 @@ inline void save(const CanvasContext &c, const char *filename)
 // -----------------------------------------------------------------------------
 
 /**
- * @brief Load attributes with exception
+ * @brief Read the attributes of a stroke tag
  *
- * @param ls node to load from
- * @param ids attributes as string array
+ * @param r Reader on the stroke tag
  *
- * @return xml_attributes
+ * @return Dimensions and info of the stroke
  */
-template<size_t n>
-auto load_attributes(const pugi::xml_node &ls, std::array<const char *, n> ids)
-	-> std::optional<std::array<pugi::xml_attribute, n>>
+inline auto read_stroke(const XmlReader &r) -> std::tuple<mth::Rect<float>, WorldLineInfo>
 {
-	std::array<pugi::xml_attribute, n> attribs;
-	std::generate(attribs.begin(), attribs.end(), [p = ids.begin(), &ls]() mutable { return ls.attribute(*p++); });
+	float	 radius, scale, x, y, w, h;
+	uint32_t color;
 
-	if (!std::none_of(attribs.begin(), attribs.end(), [](const auto &i) { return i.empty(); }))
-		return std::nullopt;
+	if (!xml_numbers(r, { "r", "c", "s", "x", "y", "w", "h" }, radius, color, scale, x, y, w, h))
+		throw std::runtime_error("A line has incomplete attributes.");
 
-	return attribs;
+	return { { x, y, w, h }, { radius, scale, (SDL_Color &)color } };
 }
 
 /**
- * @brief Load the strokes component to the canvas
+ * @brief Add a stroke read from the file
  *
  * @param c Location to store to
- * @param node XML document to load
+ * @param s Dimensions and info of the stroke
+ * @param ps Points of the stroke
  */
-inline void load_strokes(CanvasContext &c, pugi::xml_node &node)
+inline void load_stroke(CanvasContext &c, const std::tuple<mth::Rect<float>, WorldLineInfo> &s,
+						std::span<const mth::Point<float>> ps)
 {
-	for (auto ls = node.child("line").first_child(); ls != nullptr; ls = ls.next_sibling())
-	{
-		const auto attrib = load_attributes(ls, std::array{ "r", "c", "s", "x", "y", "w", "h" });
+	const auto &[dim, wli] = s;
 
-		if (!attrib)
-			throw std::runtime_error("A line has incomplete attributes.");
+	c.swts.push_back({ .dim = dim });
+	c.swls.push_back(ps, point_step(wli.scale));
+	c.swlis.push_back(wli);
+}
 
-		const auto &nodes = attrib.value();
+/**
+ * @brief Add a stroke whose points are packed in its tag
+ *
+ * @param c Location to store to
+ * @param s Dimensions and info of the stroke
+ * @param r Reader on the stroke tag
+ * @param packed Points as base64
+ * @param bytes Reused decoding buffer
+ */
+inline void load_packed_stroke(CanvasContext &c, const std::tuple<mth::Rect<float>, WorldLineInfo> &s,
+							   const XmlReader &r, const std::string &packed, std::string &bytes)
+{
+	const auto &[dim, wli] = s;
 
-		const auto radius = nodes[0].as_float();
-		const auto color  = (SDL_Color &)ctl::unmove(nodes[1].as_uint());
-		const auto scale  = nodes[2].as_float();
+	float	 step;
+	uint32_t count;
 
-		std::vector<mth::Point<float>> ps;
+	if (!xml_numbers(r, { "q", "n" }, step, count))
+		throw std::runtime_error("A line has incomplete attributes.");
 
-		for (auto l = ls.first_child(); l != nullptr; l = l.next_sibling())
-		{
-			const auto attrib = load_attributes(l, std::array{ "x", "y" });
+	base64_decode(packed, bytes);
 
-			if (!attrib)
-				throw std::runtime_error("Coords missing for a line.");
+	size_t pos = 0;
+	c.swls.push_packed(bytes, pos, count, step);
 
-			const auto &nodes = attrib.value();
+	c.swts.push_back({ .dim = dim });
+	c.swlis.push_back(wli);
+}
 
-			ps.push_back({ nodes[0].as_float(), nodes[1].as_float() });
-		}
+/**
+ * @brief Add a text read from the file
+ *
+ * @param c Location to store to
+ * @param r Reader on the text tag
+ */
+inline void load_text(CanvasContext &c, const XmlReader &r)
+{
+	float	   scale, x, y;
+	const auto text = xml_find(r, "t");
 
-		c.swts.push_back(
-			{ .dim = { nodes[3].as_float(), nodes[4].as_float(), nodes[5].as_float(), nodes[6].as_float() } });
+	if (text == nullptr || !xml_numbers(r, { "s", "x", "y" }, scale, x, y))
+		throw std::runtime_error("A text has incomplete attributes.");
 
-		c.swls.push_back({ std::move(ps) });
-		c.swlis.push_back({ radius, scale, color });
-	}
+	c.txwtxis.push_back({ .text = text_buffer(*text), .scale = scale });
+	c.txwts.push_back({ .dim = { x, y, 0.F, 0.F } });
 }
 
 /**
- * @brief Load the texts component to the canvas
+ * @brief Load XML into lines info and texture dimensions, filled tag by tag
  *
- * @param c Location to store to
- * @param node XML document to load
+ * @param c Place to load the stored information
+ * @param filename File to read
  */
-inline void load_text(CanvasContext &c, pugi::xml_node &node)
+inline void load_xml(CanvasContext &c, const char *filename)
 {
-	for (auto t = node.child("text").first_child(); t != nullptr; t = t.next_sibling())
+	static_assert(sizeof(SDL_Color) == 4, "SDL_Color must be 4 bytes long.");
+
+	auto r = xml_reader(filename);
+
+	std::string					   section; // Child of the doc the tags are in
+	std::vector<mth::Point<float>> ps;		// Reused, the db copies into its shared buffer
+	std::string					   bytes;	// Reused for packed points
+	int							   depth = 0;
+
+	std::optional<std::tuple<mth::Rect<float>, WorldLineInfo>> stroke; // Kept until its points are read
+
+	while (xml_next(r))
 	{
-		const auto attrib = load_attributes(t, std::array{ "s", "t", "x", "y" });
+		if (r.end)
+		{
+			--depth;
 
-		if (!attrib)
-			throw std::runtime_error("A text has incomplete attributes.");
+			if (depth == 2 && stroke)
+			{
+				load_stroke(c, *stroke, ps);
+				stroke.reset();
+			}
 
-		const auto &nodes = attrib.value();
+			continue;
+		}
+
+		if (depth == 0 && !xml_numbers(r, { "id", "seq" }, c.id, c.seq)) // Older files have none
+			c.id = c.seq = 0;
+
+		else if (depth == 1)
+			section = r.name;
+
+		else if (depth == 2 && section == "line")
+		{
+			ps.clear();
+			stroke = read_stroke(r);
+
+			if (const auto *packed = xml_find(r, "p"); packed != nullptr) // Older files have a tag per point
+			{
+				load_packed_stroke(c, *stroke, r, *packed, bytes);
+				stroke.reset();
+			}
+			else if (r.empty)
+			{
+				load_stroke(c, *stroke, ps);
+				stroke.reset();
+			}
+		}
 
-		const auto scale = nodes[0].as_float();
-		const auto text	 = nodes[1].as_string();
+		else if (depth == 2 && section == "text")
+			load_text(c, r);
 
-		const auto point = mth::Point<float>{ nodes[2].as_float(), nodes[3].as_float() };
+		else if (depth == 3 && stroke)
+		{
+			float x, y;
 
-		c.txwtxis.push_back({ .str = text, .scale = scale });
-		c.txwts.push_back({ .dim = { point.x, point.y, 0.F, 0.F } });
+			if (!xml_numbers(r, { "x", "y" }, x, y))
+				throw std::runtime_error("Coords missing for a line.");
+
+			ps.push_back({ x, y });
+		}
+
+		if (!r.empty)
+			++depth;
 	}
+
+	if (depth != 0)
+		throw std::runtime_error("The xml ends inside an element.");
 }
 
 /**
- * @brief Load save.xml into lines info and texture dimensions
- * @param c Place to load the stored information
+ * @brief Check if a file is a binary save from its header
  */
-inline void load(CanvasContext &c, const char *filename)
+inline auto file_binary(const char *filename) -> bool
 {
-	static_assert(sizeof(SDL_Color) == 4, "SDL_Color must be 4 bytes long.");
-
-	pugi::xml_document doc;
+	std::array<char, sizeof(FileHeader)> h = {};
+	std::ifstream						 f(filename, std::ios::binary);
 
-	auto status = doc.load_file(filename);
+	f.read(h.data(), h.size());
 
-	if (status.status != pugi::status_ok) // Handle parse error
-		throw std::runtime_error(status.description());
-
-	auto node = doc.first_child();
+	return is_binary(std::span(h.data(), (size_t)f.gcount()));
+}
 
-	load_strokes(c, node);
-	load_text(c, node);
+/**
+ * @brief Load a file, detecting whether it is binary or XML
+ *
+ * @param c Place to load the stored information
+ * @param filename File to read
+ */
+inline void load(CanvasContext &c, const char *filename)
+{
+	if (file_binary(filename))
+		load_binary(c, map_file(filename));
+	else
+		load_xml(c, filename);
 }
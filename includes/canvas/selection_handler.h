@@ -8,8 +8,11 @@
 #include "layout.h"
 #include "stroke.h"
 #include "save.h"
+#include "journal.h"
 #include "text.h"
 #include "box.h"
+#include "tile.h"
+#include "atlas.h"
 
 // -----------------------------------------------------------------------------
 // Text
@@ -24,11 +27,38 @@ inline void reset_select(CanvasContext &c)
 }
 
 /**
- * @brief Recreate the text texture with new text
+ * @brief Edit the selected text at its cursor and update its area
+ *
+ * @param r Lay out & mark damage
+ * @param c Get the selected text
+ * @param erase Bytes to remove before the cursor
+ * @param insert Text to insert at the cursor
  */
-inline void rebuild_text(Renderer &r, CanvasContext &c)
+inline void edit_selected(Renderer &r, CanvasContext &c, size_t erase, std::string_view insert)
 {
-	c.txwts[c.select.idx] = gen_text(r, c.txf, c.txwtxis[c.select.idx], c.txwts[c.select.idx].dim.pos());
+	auto &wt   = c.txwts[c.select.idx];
+	auto &wtxi = c.txwtxis[c.select.idx];
+	auto &l	   = c.txls[c.select.idx];
+
+	journal_edit_text(c, c.select.idx, erase, insert);
+	edit_text(r, c.glyphs, c.txf, wtxi.text, l, erase, insert);
+
+	const auto dim = text_dim(wt.dim.pos(), l, wtxi.scale);
+	grid_move(c.txwg, c.select.idx, wt.dim, dim);
+
+	r.refresh(c.cam.world_screen(wt.dim));
+	r.refresh(c.cam.world_screen(dim));
+
+	wt.dim = dim;
+}
+
+/**
+ * @brief Move the cursor of the selected text
+ */
+inline void move_cursor(Renderer &r, CanvasContext &c, size_t pos)
+{
+	text_move(c.txwtxis[c.select.idx].text, pos);
+	r.refresh(c.cam.world_screen(c.txwts[c.select.idx].dim));
 }
 
 /**
@@ -36,13 +66,21 @@ inline void rebuild_text(Renderer &r, CanvasContext &c)
  */
 inline void init_typing(Renderer &r, CanvasContext &c)
 {
-	const char *font_path = "res/arial.ttf";
-	auto		f		  = r.create_font(font_path, 30);
+	auto f = r.create_font(FONT_PATH, FONT_SIZE);
 
 	if (!f)
 		throw std::runtime_error("Font file not found.");
 
-	c.txf.data = std::move(*f);
+	auto sdf = r.create_font(FONT_PATH, SDF_SIZE);
+
+	if (!sdf)
+		throw std::runtime_error("Font file not found.");
+
+	c.txf.data		  = std::move(*f);
+	c.txf.sdf		  = std::move(*sdf);
+	c.glyphs.line_skip = Renderer::line_skip(c.txf.sdf);
+
+	preload_glyphs(r, c.glyphs, c.txf);
 }
 
 /**
@@ -53,55 +91,47 @@ inline void handle_typing(const SDL_Event &e, const KeyEvent &ke, const Window &
 	switch (e.type)
 	{
 	case SDL_KEYDOWN:
+	{
+		const auto &b	   = c.txwtxis[c.select.idx].text;
+		const auto	cursor = b.gap;
+
 		switch (e.key.keysym.sym)
 		{
 		case SDLK_DELETE:
-			erase(c.select.idx, c.txwts, c.txwtxis);
+			r.refresh(c.cam.world_screen(c.txwts[c.select.idx].dim));
+
+			grid_erase(c.txwg, c.select.idx, c.txwts);
+			journal_erase_text(c, c.select.idx);
+			erase(c.select.idx, c.txwts, c.txwtxis, c.txls);
 
 			stop_text_input();
 			reset_select(c);
 
 			break;
 
-		case SDLK_BACKSPACE:
-			remove_character(c.txwtxis[c.select.idx]);
-			rebuild_text(r, c);
-
-			r.refresh();
-
-			break;
-
-		case SDLK_RETURN:
-			add_character('\n', c.txwtxis[c.select.idx]);
-			rebuild_text(r, c);
-
-			r.refresh();
+		case SDLK_BACKSPACE: edit_selected(r, c, cursor - text_prev(b, cursor), ""); break;
+		case SDLK_RETURN: edit_selected(r, c, 0, "\n"); break;
 
-			break;
+		case SDLK_LEFT: move_cursor(r, c, text_prev(b, cursor)); break;
+		case SDLK_RIGHT: move_cursor(r, c, text_next(b, cursor)); break;
+		case SDLK_HOME: move_cursor(r, c, text_line_begin(b, cursor)); break;
+		case SDLK_END: move_cursor(r, c, text_line_end(b, cursor)); break;
 		}
 
 		break;
+	}
 
-	case SDL_TEXTINPUT:
-		add_character(e.text.text[0], c.txwtxis[c.select.idx]);
-		rebuild_text(r, c);
-
-		r.refresh();
-
-		break;
+	case SDL_TEXTINPUT: edit_selected(r, c, 0, e.text.text); break;
 	}
 }
 
 /**
  * @brief Draw the texts onto the window
  */
-inline void draw_texts(const Renderer &r, CanvasContext &c)
+inline void draw_texts(Renderer &r, CanvasContext &c)
 {
-	for (const auto &t : c.txwts)
-	{
-		const auto world = c.cam.world_screen(t.dim);
-		r.draw_texture(t.data, world);
-	}
+	draw_text_layouts(r, c.cam, c.glyphs, c.txwts, c.txwtxis, c.txls,
+					  grid_query(c.txwg, c.txwts, visible_area(r, c.cam)));
 }
 
 // -----------------------------------------------------------------------------
@@ -116,13 +146,35 @@ inline auto is_selected(CanvasContext &c) -> bool
 	return c.select.wt != nullptr;
 }
 
+/**
+ * @brief Mark the outline & caret of the selection to be redrawn, before it changes
+ */
+inline void refresh_selection(Renderer &r, CanvasContext &c)
+{
+	if (is_selected(c))
+		r.refresh(c.cam.world_screen(c.select.wt->dim));
+}
+
 /**
  * @brief Move the selected texture by a delta
  */
 inline void move_selected(CanvasContext &c, float dx, float dy)
 {
+	const auto from = c.select.wt->dim;
+
 	c.select.wt->dim.x += dx / c.cam.scale;
 	c.select.wt->dim.y += dy / c.cam.scale;
+	c.select.moved = true;
+
+	if (c.select.type == CanvasType::STROKE)
+	{
+		grid_move(c.swg, c.select.idx, from, c.select.wt->dim);
+		tile_invalidate(c.tiles, c.regen, from);
+		tile_invalidate(c.tiles, c.regen, c.select.wt->dim);
+		c.tiles.drag_tick = SDL_GetTicks();
+	}
+	else
+		grid_move(c.txwg, c.select.idx, from, c.select.wt->dim);
 }
 
 /**
@@ -130,10 +182,14 @@ inline void move_selected(CanvasContext &c, float dx, float dy)
  */
 inline void push_empty_text(Renderer &r, CanvasContext &c, mth::Point<float> wp)
 {
-	auto [txi, txt] = start_new_text(r, c.txf, wp, c.cam.scale);
+	auto [txi, txt, txl] = start_new_text(r, c.glyphs, c.txf, wp, c.cam.scale);
+
+	grid_insert(c.txwg, c.txwts.size(), txt.dim);
 
 	c.txwts.push_back(std::move(txt));
 	c.txwtxis.push_back(std::move(txi));
+	c.txls.push_back(std::move(txl));
+	journal_add_text(c);
 
 	start_text_input();
 }
@@ -153,6 +209,7 @@ inline void handle_selecting(const SDL_Event &e, const KeyEvent &ke, const Windo
 	switch (e.type)
 	{
 	case EVENT_DRAW:
+		refresh_selection(r, c);
 		stop_select(c);
 		start_painting(c);
 
@@ -163,8 +220,9 @@ inline void handle_selecting(const SDL_Event &e, const KeyEvent &ke, const Windo
 		{
 			if (is_selected(c))
 			{
+				refresh_selection(r, c);
 				move_selected(c, e.motion.xrel, e.motion.yrel);
-				r.refresh();
+				refresh_selection(r, c);
 			}
 		}
 
@@ -175,6 +233,12 @@ inline void handle_selecting(const SDL_Event &e, const KeyEvent &ke, const Windo
 		{
 			ctl::print("Reset temp line\n");
 			c.start_mp.reset();
+
+			if (is_selected(c) && c.select.moved)
+			{
+				journal_move(c);
+				c.select.moved = false;
+			}
 		}
 
 		break;
@@ -184,10 +248,12 @@ inline void handle_selecting(const SDL_Event &e, const KeyEvent &ke, const Windo
 		{
 			const auto wp = c.cam.screen_world(sdl::mouse_position());
 
+			refresh_selection(r, c); // Erase the previous outline, before a new text moves the textures
+
 			if (e.button.clicks == 2)
 				push_empty_text(r, c, wp);
 
-			c.select = start_selecting(c.swts, c.txwts, wp);
+			c.select = start_selecting(c.swts, c.swg, c.txwts, c.txwg, wp);
 
 			ctl::print("Index: %d\n", c.select.idx);
 
@@ -203,7 +269,7 @@ inline void handle_selecting(const SDL_Event &e, const KeyEvent &ke, const Windo
 				if (c.select.type != CanvasType::TEXT)
 					stop_text_input();
 
-				r.refresh();
+				refresh_selection(r, c);
 			}
 		}
 
@@ -225,4 +291,18 @@ inline void draw_selection(const Renderer &r, CanvasContext &c)
 		r.set_draw_color(sdl::BLUE);
 		r.draw_rect(c.cam.world_screen(c.select.wt->dim));
 	}
+
+	if (c.select.type == CanvasType::TEXT)
+	{
+		const auto &wtxi = c.txwtxis[c.select.idx];
+
+		const auto p = text_caret(c.glyphs, wtxi.text, c.txls[c.select.idx]);
+		const auto s = SDF_RATIO / wtxi.scale;
+		const auto o = c.select.wt->dim.pos();
+
+		const auto top = c.cam.world_screen(mth::Point<float>{ o.x + p.x * s, o.y + p.y * s });
+		const auto bot = c.cam.world_screen(mth::Point<float>{ o.x + p.x * s, o.y + (p.y + c.glyphs.line_skip) * s });
+
+		r.draw_line(top, bot);
+	}
 }
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+#include <CustomLibrary/Collider.h>
+
+#include "layout.h"
+
+using namespace ctl;
+
+/**
+ * @brief Pack a cell coordinate into a map key
+ */
+constexpr auto grid_key(int32_t x, int32_t y) -> uint64_t
+{
+	return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+}
+
+/**
+ * @brief Get the cell range covered by a world area
+ *
+ * @param r World area
+ *
+ * @return Inclusive cell range as { x, y, w, h } where w & h are cell counts - 1
+ */
+inline auto grid_range(const mth::Rect<float> &r) -> mth::Rect<int32_t>
+{
+	const auto x1 = (int32_t)std::floor(r.x / GRID_CELL);
+	const auto y1 = (int32_t)std::floor(r.y / GRID_CELL);
+	const auto x2 = (int32_t)std::floor((r.x + r.w) / GRID_CELL);
+	const auto y2 = (int32_t)std::floor((r.y + r.h) / GRID_CELL);
+
+	return { x1, y1, x2 - x1, y2 - y1 };
+}
+
+/**
+ * @brief Insert an index into all cells covered by its area
+ *
+ * @param g Grid to insert into
+ * @param i Index of the object
+ * @param r World area of the object
+ */
+inline void grid_insert(SpatialGrid &g, size_t i, const mth::Rect<float> &r)
+{
+	const auto cr = grid_range(r);
+
+	for (auto y = cr.y; y <= cr.y + cr.h; ++y)
+		for (auto x = cr.x; x <= cr.x + cr.w; ++x) g.cells[grid_key(x, y)].push_back(i);
+}
+
+/**
+ * @brief Remove an index from all cells covered by its area
+ *
+ * @param g Grid to remove from
+ * @param i Index of the object
+ * @param r World area the object was inserted with
+ */
+inline void grid_remove(SpatialGrid &g, size_t i, const mth::Rect<float> &r)
+{
+	const auto cr = grid_range(r);
+
+	for (auto y = cr.y; y <= cr.y + cr.h; ++y)
+		for (auto x = cr.x; x <= cr.x + cr.w; ++x)
+		{
+			const auto cell = g.cells.find(grid_key(x, y));
+
+			if (cell == g.cells.end())
+				continue;
+
+			auto &is = cell->second;
+
+			if (const auto f = std::find(is.begin(), is.end(), i); f != is.end())
+			{
+				*f = is.back();
+				is.pop_back();
+			}
+
+			if (is.empty())
+				g.cells.erase(cell);
+		}
+}
+
+/**
+ * @brief Move an object to a new area
+ *
+ * @param g Grid to update
+ * @param i Index of the object
+ * @param from Previous world area
+ * @param to New world area
+ */
+inline void grid_move(SpatialGrid &g, size_t i, const mth::Rect<float> &from, const mth::Rect<float> &to)
+{
+	const auto fr = grid_range(from);
+	const auto tr = grid_range(to);
+
+	if (fr.x == tr.x && fr.y == tr.y && fr.w == tr.w && fr.h == tr.h) // Still in the same cells
+		return;
+
+	grid_remove(g, i, from);
+	grid_insert(g, i, to);
+}
+
+/**
+ * @brief Mirror the quick erase of a db inside the grid (last element takes the place of i)
+ *
+ * @param g Grid to update
+ * @param i Index being erased
+ * @param wts Texture db before erasing
+ */
+inline void grid_erase(SpatialGrid &g, size_t i, const WorldTextureDB &wts)
+{
+	const auto last = wts.size() - 1;
+
+	grid_remove(g, i, wts[i].dim);
+
+	if (i == last)
+		return;
+
+	grid_remove(g, last, wts[last].dim);
+	grid_insert(g, i, wts[last].dim);
+}
+
+/**
+ * @brief Reinsert every object of a db
+ *
+ * @param g Grid to fill
+ * @param wts Textures to index
+ */
+inline void grid_rebuild(SpatialGrid &g, const WorldTextureDB &wts)
+{
+	g.clear();
+
+	for (size_t i = 0; i < wts.size(); ++i) grid_insert(g, i, wts[i].dim);
+}
+
+/**
+ * @brief Find all objects intersecting a world area
+ *
+ * @param g Grid to search in
+ * @param wts Textures for exact collision
+ * @param r World area
+ *
+ * @return Indices sorted in db order
+ */
+inline auto grid_query(const SpatialGrid &g, const WorldTextureDB &wts, const mth::Rect<float> &r) -> std::vector<size_t>
+{
+	std::vector<size_t> idx;
+
+	const auto cr = grid_range(r);
+
+	if ((uint64_t)(cr.w + 1) * (uint64_t)(cr.h + 1) > g.cells.size()) // Area covers more cells than exist
+	{
+		for (const auto &[_, is] : g.cells) idx.insert(idx.end(), is.begin(), is.end());
+	}
+	else
+	{
+		for (auto y = cr.y; y <= cr.y + cr.h; ++y)
+			for (auto x = cr.x; x <= cr.x + cr.w; ++x)
+				if (const auto cell = g.cells.find(grid_key(x, y)); cell != g.cells.end())
+					idx.insert(idx.end(), cell->second.begin(), cell->second.end());
+	}
+
+	std::sort(idx.begin(), idx.end());
+	idx.erase(std::unique(idx.begin(), idx.end()), idx.end());
+	std::erase_if(idx, [&wts, &r](size_t i) { return !mth::collision(wts[i].dim, r); });
+
+	return idx;
+}
+
+/**
+ * @brief Find the topmost object containing a world point
+ *
+ * @param g Grid to search in
+ * @param wts Textures for exact collision
+ * @param wp World point
+ *
+ * @return Index of the object if found
+ */
+inline auto grid_query(const SpatialGrid &g, const WorldTextureDB &wts, mth::Point<float> wp) -> std::optional<size_t>
+{
+	const auto cell = g.cells.find(
+		grid_key((int32_t)std::floor(wp.x / GRID_CELL), (int32_t)std::floor(wp.y / GRID_CELL)));
+
+	if (cell == g.cells.end())
+		return std::nullopt;
+
+	std::optional<size_t> top;
+
+	for (auto i : cell->second)
+		if ((!top || i > *top) && mth::collision(wts[i].dim, wp))
+			top = i;
+
+	return top;
+}
+
+/**
+ * @brief Get the world area being redrawn on the screen
+ *
+ * @param r Get the screen or damaged area
+ * @param cam Camera to transform with
+ */
+inline auto visible_area(const Renderer &r, const sdl::Camera2D &cam) -> mth::Rect<float>
+{
+	return cam.screen_world(r.get_draw_area());
+}
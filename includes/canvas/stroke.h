@@ -1,5 +1,8 @@
 #pragma once
 
+#include <span>
+#include <cmath>
+#include <vector>
 #include <algorithm>
 
 #include <CustomLibrary/IO.h>
@@ -8,23 +11,26 @@
 #include "window.h"
 #include "event.h"
 #include "layout.h"
+#include "spatial.h"
+#include "intersect.h"
+#include "transform.h"
 
 using namespace ctl;
 
 /**
- * @brief Shrink texture to draw area
+ * @brief Get the area covered by a stroke path
  *
- * @param r Generate new texture
- * @param c	Access lines array
+ * @param ps Points of the path
+ * @param rad Stroke radius
  *
- * @return Shrunk texture
+ * @return Area including the radius
  */
-inline auto get_line_dim(const Renderer &r, const ScreenLine &sl, const ScreenLineInfo &sli) -> mth::Rect<int>
+inline auto get_path_dim(std::span<const mth::Point<int>> ps, float rad) -> mth::Rect<int>
 {
 	SDL_Point min = { std::numeric_limits<int>::max(), std::numeric_limits<int>::max() };
-	SDL_Point max = { 0, 0 };
+	SDL_Point max = { std::numeric_limits<int>::min(), std::numeric_limits<int>::min() };
 
-	for (const auto &p : sl.points) // Find line range inside texture
+	for (const auto &p : ps) // Find line range inside texture
 	{
 		min.x = std::min(min.x, p.x);
 		min.y = std::min(min.y, p.y);
@@ -32,41 +38,81 @@ inline auto get_line_dim(const Renderer &r, const ScreenLine &sl, const ScreenLi
 		max.y = std::max(max.y, p.y);
 	}
 
-	const auto rad = sli.radius;
+	const auto e = (int)std::ceil(rad); // Thin strokes when zoomed out still cover a pixel
 
-	min.x -= (int)rad;
-	min.y -= (int)rad;
-	max.x += (int)rad;
-	max.y += (int)rad;
+	min.x -= e;
+	min.y -= e;
+	max.x += e;
+	max.y += e;
 
-	const auto w = max.x - min.x;
-	const auto h = max.y - min.y;
+	const auto w = std::max(max.x - min.x, 1); // Dots & straight lines of a zero radius
+	const auto h = std::max(max.y - min.y, 1);
 
 	return { min.x, min.y, w, h };
 }
 
 /**
- * @brief Render a stroke connection between 2 strokes
+ * @brief Shrink texture to draw area
+ *
+ * @param r Generate new texture
+ * @param c	Access lines array
+ *
+ * @return Shrunk texture
+ */
+inline auto get_line_dim(const Renderer &r, const ScreenLine &sl, const ScreenLineInfo &sli) -> mth::Rect<int>
+{
+	return get_path_dim(sl.points, sli.radius);
+}
+
+/**
+ * @brief Get the buffer area needed to also cover a new area
+ *
+ * @param buf Current buffer area
+ * @param need Area that must be covered
+ *
+ * @return Buffer area grown with a margin on the overflowing sides
+ */
+inline auto fit_stroke_area(mth::Rect<int> buf, mth::Rect<int> need) -> mth::Rect<int>
+{
+	const auto m = std::max(STROKE_MARGIN, std::max(buf.w, buf.h) / 2); // Amortize regrowing
+
+	const auto x1 = need.x < buf.x ? need.x - m : buf.x;
+	const auto y1 = need.y < buf.y ? need.y - m : buf.y;
+	const auto x2 = need.x + need.w > buf.x + buf.w ? need.x + need.w + m : buf.x + buf.w;
+	const auto y2 = need.y + need.h > buf.y + buf.h ? need.y + need.h + m : buf.y + buf.h;
+
+	return { x1, y1, x2 - x1, y2 - y1 };
+}
+
+/**
+ * @brief Render a stroke path in one go
  *
  * @param r Get draw functions
- * @param st Get texture to draw to
+ * @param sb Get buffer to draw to
  * @param sli Get radius information
- * @param from Point to draw from
- * @param to Point to draw to
+ * @param path Points to connect (a single point is a dot)
  */
-inline void render_conn(Renderer &r, ScreenTexture &st, const ScreenLineInfo &sli, mth::Line<int> path)
+inline void render_path(Renderer &r, Renderer::StrokeBuffer &sb, const ScreenLineInfo &sli,
+						std::span<mth::Point<int>> path)
 {
-	const auto abs = path.abs_rect();
+	const auto area = get_path_dim(path, sli.radius);
 
-	const mth::Rect<int> area = { abs.x - (int)sli.radius, abs.y - (int)sli.radius, abs.w + (int)sli.radius * 2,
-								  abs.h + (int)sli.radius * 2 };
+	if (const auto fit = fit_stroke_area(sb.area, area);
+		fit.x != sb.area.x || fit.y != sb.area.y || fit.w != sb.area.w || fit.h != sb.area.h)
+		r.grow_stroke_buffer(sb, fit);
 
-	r.set_stroke_target(st.data, area, sli.radius);
+	r.set_stroke_buffer(sb);
+	r.set_stroke_width(sli.radius);
 
 	r.set_stroke_color(sli.color);
-	r.draw_stroke(path.pos1(), path.pos2());
 
-	r.render_stroke(st.data);
+	if (path.size() == 1)
+		r.draw_stroke(path[0], path[0]);
+	else
+		r.draw_stroke_multi(path);
+
+	r.upload_stroke_buffer(sb, area); // One upload for the whole path
+	r.refresh(area);
 }
 
 /**
@@ -77,40 +123,51 @@ inline void render_conn(Renderer &r, ScreenTexture &st, const ScreenLineInfo &sl
  * @param c Fill out target data
  */
 inline auto start_stroke(const Window &w, Renderer &r, const ScreenLineInfo &sli)
-	-> std::pair<ScreenTexture, ScreenLine>
+	-> std::pair<Renderer::StrokeBuffer, ScreenLine>
 {
-	const auto mp	  = sdl::mouse_position();
-	const auto w_size = w.get_windowsize();
+	const auto mp  = sdl::mouse_position();
+	const auto ext = (int)sli.radius + STROKE_MARGIN;
 
-	auto t = r.create_stroke_texture(w_size.w, w_size.h);
-	r.render_stroke(t);
+	auto	   sb = r.create_stroke_buffer({ mp.x - ext, mp.y - ext, ext * 2, ext * 2 });
+	ScreenLine sl = { .points = { { mp.x, mp.y } } };
 
-	ScreenTexture st = { .dim = { 0, 0, w_size.w, w_size.h }, .data = std::move(t) };
-	ScreenLine	  sl = { .points = { { mp.x, mp.y } } };
+	render_path(r, sb, sli, sl.points);
 
-	render_conn(r, st, sli, mth::Line<int>::from(mp, mp));
-
-	return { std::move(st), std::move(sl) };
+	return { std::move(sb), std::move(sl) };
 }
 
 /**
- * @brief Add & draw new location to target if not a duplicate
+ * @brief Queue new location to target if not a duplicate
  *
- * @param w Get mouse position
- * @param r Render line to texture and window
- * @param c Add target data
+ * @param sl Add target data
  */
-inline void continue_stroke(const Window &w, Renderer &r, ScreenTexture &st, ScreenLine &sl, const ScreenLineInfo &sli)
+inline void continue_stroke(ScreenLine &sl)
 {
 	const auto mp = sdl::mouse_position();
 
 	if (mp == sl.points.back()) // Some systems (like linux) have multiple events...
 		return;
 
-	render_conn(r, st, sli, mth::Line<int>::from(sl.points.back(), mp));
 	sl.points.push_back(mp);
 }
 
+/**
+ * @brief Draw all queued locations as one path
+ *
+ * @param r Render line to texture and window
+ * @param sb Buffer to draw to
+ * @param sl Target data with queued points
+ * @param sli Radius & color
+ */
+inline void flush_stroke(Renderer &r, Renderer::StrokeBuffer &sb, ScreenLine &sl, const ScreenLineInfo &sli)
+{
+	if (sl.drawn + 1 >= sl.points.size())
+		return;
+
+	render_path(r, sb, sli, std::span(sl.points).subspan(sl.drawn)); // Start at the last drawn point to connect
+	sl.drawn = sl.points.size() - 1;
+}
+
 /**
  * @brief Finalize target and store it
  *
@@ -120,15 +177,29 @@ inline void continue_stroke(const Window &w, Renderer &r, ScreenTexture &st, Scr
  *
  * @return Finished stroke
  */
-inline auto finalize_stroke(const Window &w, Renderer &r, ScreenTexture &st, ScreenLine &sl, const ScreenLineInfo &sli)
-	-> ScreenTexture
+inline auto finalize_stroke(const Window &w, Renderer &r, const Renderer::StrokeBuffer &sb, ScreenLine &sl,
+							const ScreenLineInfo &sli) -> ScreenTexture
 {
 	const auto line_dim = get_line_dim(r, sl, sli);
-	auto	   tex		= r.crop_texture(st.data, line_dim);
+	auto	   tex		= r.crop_stroke_buffer(sb, line_dim); // Straight from the cpu buffer
 
 	return { .dim = line_dim, .data = std::move(tex) };
 }
 
+/**
+ * @brief Get the scale a stroke should be rasterized at for a camera scale
+ *
+ * @param dim World size of the stroke
+ * @param scale Camera scale
+ *
+ * @return Nearest power of 2 limited by STROKE_TEXTURE_MAX
+ */
+inline auto stroke_lod_scale(const mth::Rect<float> &dim, float scale) -> float
+{
+	const auto s = std::exp2(std::round(std::log2(scale)));
+	return std::min(s, STROKE_TEXTURE_MAX / std::max({ dim.w, dim.h, 1.F }));
+}
+
 /**
  * @brief Transform screen line to a world line
  *
@@ -143,10 +214,10 @@ inline auto transform_target_line(const sdl::Camera2D &cam, ScreenTexture &st, S
 								  const ScreenLineInfo &sli) -> std::tuple<WorldTexture, WorldLine, WorldLineInfo>
 {
 	WorldTexture wt = { .dim = cam.screen_world(st.dim), .data = std::move(st.data) };
+	wt.res			= stroke_lod_scale(wt.dim, cam.scale); // The level regen_strokes_lod compares to, not the raw scale
 
 	WorldLine wl = { .points = std::vector<mth::Point<float>>(sl.points.size()) };
-	std::transform(sl.points.begin(), sl.points.end(), wl.points.begin(),
-				   [&cam, &wt](mth::Point<int> p) { return cam.screen_world(p) - wt.dim.pos(); });
+	screen_world_batch(cam, sl.points, wl.points, wt.dim.pos());
 
 	WorldLineInfo wli = { .radius = sli.radius, .scale = cam.scale, .color = sli.color };
 
@@ -156,82 +227,373 @@ inline auto transform_target_line(const sdl::Camera2D &cam, ScreenTexture &st, S
 /**
  * @brief Clear info from screen line
  *
+ * @param sb Live stroke buffer
  * @param st Screen texture
  * @param sl Screen line
  */
-inline void clear_target_line(ScreenTexture &st, ScreenLine &sl)
+inline void clear_target_line(Renderer::StrokeBuffer &sb, ScreenTexture &st, ScreenLine &sl)
 {
+	sb = {};
 	st.data.reset();
 	sl.points.clear();
 }
 
 /**
- * @brief Find all points intersecting with given point
+ * @brief Drop the points of erased strokes once they fill half of the buffer
+ *
+ * @param wls Lines to compact (kept in index order)
+ */
+inline void compact_lines(WorldLineDB &wls)
+{
+	if (wls.dead * 2 <= wls.pts.size())
+		return;
+
+	std::vector<LinePoint> pts;
+	pts.reserve(wls.pts.size() - wls.dead);
+
+	for (auto &l : wls.lines)
+	{
+		if (l.mapped) // Stays in the file
+			continue;
+
+		const auto o = (uint32_t)pts.size();
+		pts.insert(pts.end(), wls.pts.begin() + l.offset, wls.pts.begin() + l.offset + l.count);
+		l.offset = o;
+	}
+
+	wls.pts	 = std::move(pts);
+	wls.dead = 0;
+}
+
+/**
+ * @brief Get the distance of a point to a segment
+ */
+inline auto segment_distance(mth::Point<float> p, mth::Point<float> a, mth::Point<float> b) -> float
+{
+	const auto dx = b.x - a.x;
+	const auto dy = b.y - a.y;
+	const auto l  = dx * dx + dy * dy;
+
+	const auto t = l == 0.F ? 0.F : std::clamp(((p.x - a.x) * dx + (p.y - a.y) * dy) / l, 0.F, 1.F);
+
+	return std::hypot(p.x - a.x - t * dx, p.y - a.y - t * dy);
+}
+
+/**
+ * @brief Get the world distance a stroke may deviate by when simplified
+ *
+ * @param wli Width of the stroke and the camera scale it was drawn at
+ */
+inline auto simplify_tolerance(const WorldLineInfo &wli) -> float
+{
+	return SIMPLIFY_TOLERANCE * wli.radius / wli.scale;
+}
+
+/**
+ * @brief Drop the points of a polyline within a tolerance (Ramer-Douglas-Peucker)
+ *
+ * @param ps Points to simplify
+ * @param eps Largest distance of a dropped point to the simplified line
+ *
+ * @return Kept points, always including the first and the last
+ */
+inline auto simplify_line(std::span<const mth::Point<float>> ps, float eps) -> std::vector<mth::Point<float>>
+{
+	if (ps.size() < 3)
+		return { ps.begin(), ps.end() };
+
+	std::vector<bool>					   keep(ps.size(), false);
+	std::vector<std::pair<size_t, size_t>> todo = { { 0, ps.size() - 1 } };
+
+	keep.front() = keep.back() = true;
+
+	while (!todo.empty())
+	{
+		const auto [a, b] = todo.back();
+		todo.pop_back();
+
+		float  m = 0.F;
+		size_t f = a;
+
+		for (size_t i = a + 1; i < b; ++i)
+			if (const auto d = segment_distance(ps[i], ps[a], ps[b]); d > m)
+			{
+				m = d;
+				f = i;
+			}
+
+		if (m <= eps)
+			continue;
+
+		keep[f] = true;
+		todo.push_back({ a, f });
+		todo.push_back({ f, b });
+	}
+
+	std::vector<mth::Point<float>> res;
+
+	for (size_t i = 0; i < ps.size(); ++i)
+		if (keep[i])
+			res.push_back(ps[i]);
+
+	return res;
+}
+
+/**
+ * @brief Simplify all stored strokes, rebuilding the point buffer
+ *
+ * @param wls Lines to simplify
+ * @param wlis Tolerance of each line
+ *
+ * @return Point counts before and after
+ */
+inline auto simplify_lines(WorldLineDB &wls, const WorldLineInfoDB &wlis) -> SimplifyStats
+{
+	SimplifyStats st;
+	WorldLineDB	  res;
+
+	res.lines.reserve(wls.size());
+
+	for (size_t i = 0; i < wls.size(); ++i)
+	{
+		const auto ls = wls.points(i);
+		const auto ps = std::vector<mth::Point<float>>(ls.begin(), ls.end());
+		const auto s  = simplify_line(ps, simplify_tolerance(wlis[i]));
+
+		st.before += ps.size();
+		st.after += s.size();
+
+		res.push_back(s, wls[i].step); // Already on the grid of the step
+	}
+
+	wls = std::move(res);
+	return st;
+}
+
+/**
+ * @brief Get the detail level to draw a stroke with at a camera scale
+ *
+ * @param wli Scale the stroke was drawn at
+ * @param scale Camera scale
+ *
+ * @return 0 for the stored points, up to LOD_LEVELS for the coarsest
+ */
+inline auto lod_level(const WorldLineInfo &wli, float scale) -> int
+{
+	return std::clamp((int)std::floor(std::log2(wli.scale / scale)), 0, LOD_LEVELS);
+}
+
+/**
+ * @brief Simplify a line for each detail level
+ *
+ * @param wls Lines to simplify
+ * @param wlis Scale of each line
+ * @param i Line to build the levels of
+ *
+ * @return Levels from 1 to LOD_LEVELS, each at double the tolerance
+ */
+inline auto build_lods(WorldLineDB &wls, const WorldLineInfoDB &wlis, size_t i) -> WorldLineDB
+{
+	const auto ls = wls.points(i);
+	const auto ps = std::vector<mth::Point<float>>(ls.begin(), ls.end());
+
+	WorldLineDB res;
+
+	for (int l = 1; l <= LOD_LEVELS; ++l)
+		res.push_back(simplify_line(ps, LOD_TOLERANCE * std::ldexp(1.F, l) / wlis[i].scale), wls.lines[i].step);
+
+	return res;
+}
+
+/**
+ * @brief Get the coarsest points of a stroke accurate at a camera scale
+ *
+ * @param lods Levels of each line, built on demand
+ * @param wls Stored lines
+ * @param wlis Line infos
+ * @param i Line to get
+ * @param scale Camera scale
+ */
+inline auto lod_points(WorldLodDB &lods, WorldLineDB &wls, const WorldLineInfoDB &wlis, size_t i, float scale)
+	-> LinePoints
+{
+	const auto l = lod_level(wlis[i], scale);
+
+	if (l == 0)
+		return wls.points(i);
+
+	if (lods[i].empty())
+		lods[i] = build_lods(wls, wlis, i);
+
+	return lods[i].points(l - 1);
+}
+
+/**
+ * @brief Find all strokes crossed by the erase line
  *
- * @param c Get all lines
- * @param p Point in world to compare to
+ * @param g Spatial index of the strokes
+ * @param wts Stroke dimensions
+ * @param wls Stroke lines
+ * @param wlis Stroke infos
+ * @param lods Simplified levels of the lines
+ * @param bounds Chunks of the long lines, built on demand
+ * @param e1 Erase line start in world
+ * @param e2 Erase line end in world
+ * @param scale Camera scale to pick the levels for
  *
  * @return Collection of indexes for collisions
  */
-inline auto find_line_intersections(const WorldTextureDB &wts, const WorldLineDB &wls, const WorldLineInfoDB &wlis,
-									mth::Line<float> ml) -> std::vector<size_t>
+inline auto find_line_intersections(const SpatialGrid &g, const WorldTextureDB &wts, WorldLineDB &wls,
+									const WorldLineInfoDB &wlis, WorldLodDB &lods, LineBoundsDB &bounds,
+									mth::Point<float> e1, mth::Point<float> e2, float scale) -> std::vector<size_t>
 {
+	const auto ml = mth::Line<float>::from(e1, e2);
+
 	std::vector<size_t> idx;
+	std::vector<float>	xs, ys;
 
-	for (size_t i = 0; i < wts.size(); ++i)
+	for (size_t i : grid_query(g, wts, ml.abs_rect()))
 		if (mth::collision(ml, wts[i].dim))
 		{
-			const auto &ps = wls[i].points;
+			const auto ps = lod_points(lods, wls, wlis, i, scale);
 
-			if (ps.size() < 5) // If dot-like texture (also protects search)
+			if (ps.size() < 2) // If dot-like texture (also protects search)
 			{
 				idx.push_back(i);
 				continue;
 			}
 
-			for (auto ii = ps.begin(); ii != ps.end() - 1; ++ii)
-				if (mth::collision(mth::Line<float>::from(*ii + wts[i].dim.pos(), *(ii + 1) + wts[i].dim.pos()), ml))
+			// Move the erase line into the stroke instead of every point out of it
+			const auto p = e1 - wts[i].dim.pos();
+			const auto q = e2 - wts[i].dim.pos();
+
+			if (ps.size() <= SEGMENT_CHUNK + 1)
+			{
+				decode_points(ps, xs, ys);
+
+				if (polyline_crosses(xs.data(), ys.data(), xs.size(), p, q))
+					idx.push_back(i);
+
+				continue;
+			}
+
+			const auto level = lod_level(wlis[i], scale);
+
+			if (bounds[i].level != level)
+				bounds[i] = build_bounds(ps, level);
+
+			const auto lc = mth::Line<float>::from(p, q);
+
+			for (const auto &c : bounds[i].chunks)
+			{
+				if (!mth::collision(lc, c.area))
+					continue;
+
+				decode_points(chunk_points(ps, c), xs, ys);
+
+				if (polyline_crosses(xs.data(), ys.data(), xs.size(), p, q))
 				{
 					idx.push_back(i);
 					break;
 				}
+			}
 		}
 
 	return idx;
 }
 
+/**
+ * @brief Rasterize a stroke at a given scale
+ *
+ * @param r Draw & render the line onto a texture
+ * @param dim World dimensions of the stroke
+ * @param ps Points relative to the dimensions
+ * @param wli Radius & color
+ * @param scale Scale to rasterize at
+ *
+ * @return Stroke texture
+ */
+inline auto gen_stroke(Renderer &r, const mth::Rect<float> &dim, const LinePoints &ps, const WorldLineInfo &wli,
+					   float scale) -> Renderer::CacheTexture
+{
+	sdl::Camera2D cam{ .loc = { 0.F, 0.F }, .scale = scale };
+
+	const auto d	  = cam.world_screen(mth::Dim<float>{ dim.w, dim.h });
+	const auto t_size = mth::Dim<int>{ std::max(d.w, 1), std::max(d.h, 1) };
+	auto	   t	  = r.create_stroke_texture(t_size.w, t_size.h);
+	const auto rad	  = wli.radius / wli.scale * scale;
+
+	r.set_stroke_color(wli.color);
+	r.set_stroke_target(t, { 0, 0, t_size.w, t_size.h }, rad);
+
+	std::vector<mth::Point<int>> ps_pos(ps.size());
+	world_screen_batch(cam, ps, ps_pos);
+
+	if (ps_pos.size() == 1) // Dots
+		r.draw_stroke(ps_pos[0], ps_pos[0]);
+	else
+		r.draw_stroke_multi(ps_pos);
+
+	r.render_stroke(t);
+
+	return t;
+}
+
 /**
  * @brief Generate textures using the stored list of lines
  *
  * @param r Draw & render lines onto textures
  * @param c Store the generated textures
  */
-inline void regen_strokes(Renderer &r, WorldTextureDB &wts, const WorldLineDB &wls, const WorldLineInfoDB &wlis)
+inline void regen_strokes(Renderer &r, WorldTextureDB &wts, WorldLineDB &wls, const WorldLineInfoDB &wlis)
 {
 	for (size_t i = 0; i < wts.size(); ++i)
 	{
-		auto		 &wt	= wts[i];
-		const auto &wl	= wls[i];
-		const auto &wli = wlis[i];
+		auto &wt = wts[i];
 
-		sdl::Camera2D cam{ .loc = { 0.F, 0.F }, .scale = wli.scale };
+		wt.res	= stroke_lod_scale(wt.dim, wlis[i].scale);
+		wt.data = gen_stroke(r, wt.dim, wls.points(i), wlis[i], wt.res);
+	}
+}
 
-		const auto t_size = cam.world_screen(mth::Dim<float>{ wt.dim.w, wt.dim.h });
-		auto	   t	  = r.create_stroke_texture(t_size.w, t_size.h);
-		const auto rad	  = wli.radius;
+/**
+ * @brief Rerasterize visible strokes not matching the camera resolution
+ *
+ * @param r Draw the new textures
+ * @param wts Textures to replace (old ones stay until replaced)
+ * @param wls Lines to rasterize
+ * @param wlis Line infos
+ * @param lods Simplified levels of the lines
+ * @param idx Visible strokes
+ * @param scale Camera scale
+ * @param budget Maximum of strokes to rasterize
+ *
+ * @return Rerasterized strokes, all done if less than budget
+ */
+inline auto regen_strokes_lod(Renderer &r, WorldTextureDB &wts, WorldLineDB &wls, const WorldLineInfoDB &wlis,
+							  WorldLodDB &lods, std::span<const size_t> idx, float scale, size_t budget)
+	-> std::vector<size_t>
+{
+	std::vector<size_t> done;
 
-		r.set_stroke_color(wli.color);
-		r.set_stroke_target(t, { 0, 0, t_size.w, t_size.h }, rad);
+	for (auto i : idx)
+	{
+		if (done.size() == budget)
+			break;
 
-		std::vector<mth::Point<int>> ps_pos(wl.points.size());
-		std::transform(wl.points.begin(), wl.points.end(), ps_pos.begin(),
-					   [&cam](mth::Point<float> p) { return cam.world_screen(p); });
+		auto	  &wt  = wts[i];
+		const auto res = stroke_lod_scale(wt.dim, scale);
 
-		r.draw_stroke_multi(ps_pos);
+		if (wt.job != 0 || wt.res == res) // Leave pending ones to the workers
+			continue;
 
-		r.render_stroke(t);
-		wt.data = std::move(t);
+		wt.data = gen_stroke(r, wt.dim, lod_points(lods, wls, wlis, i, res), wlis[i], res);
+		wt.res	= res;
+
+		done.push_back(i);
 	}
+
+	return done;
 }
 
 /**
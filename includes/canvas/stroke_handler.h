@@ -8,15 +8,19 @@
 #include "layout.h"
 #include "stroke.h"
 #include "save.h"
+#include "journal.h"
 #include "text.h"
 #include "box.h"
+#include "tile.h"
+#include "atlas.h"
+#include "mesh.h"
 
 /**
  * @brief Check if the stroke has started
  */
 inline auto stroke_started(CanvasContext &c) -> bool
 {
-	return c.sst.data != nullptr;
+	return c.ssb.tex != nullptr;
 }
 
 /**
@@ -34,11 +38,24 @@ inline void add_stroke(CanvasContext &c)
 {
 	auto [wt, wl, wli] = transform_target_line(c.cam, c.sst, c.ssl, c.ssli);
 
+	const auto ps = simplify_line(wl.points, simplify_tolerance(wli));
+	c.simplify.before += wl.points.size();
+	c.simplify.after += ps.size();
+
+	grid_insert(c.swg, c.swts.size(), wt.dim);
+	tile_invalidate(c.tiles, c.regen, wt.dim);
+
+	atlas_queue(c.atlas, c.swts.size());
+
 	c.swts.push_back(std::move(wt));
-	c.swls.push_back(std::move(wl));
+	c.swls.push_back(ps, point_step(wli.scale));
 	c.swlis.push_back(wli);
+	c.swlods.emplace_back(); // Simplified when zoomed out
+	c.swbs.emplace_back();	 // Bounded when erasing
+	c.swms.emplace_back();	 // Tessellated when drawn
+	journal_add_stroke(c);
 
-	clear_target_line(c.sst, c.ssl);
+	clear_target_line(c.ssb, c.sst, c.ssl);
 }
 
 /**
@@ -56,10 +73,20 @@ inline void erase_path(CanvasContext &c)
 {
 	const auto wp = c.cam.screen_world(sdl::mouse_position());
 
-	auto col = find_line_intersections(c.swts, c.swls, c.swlis, mth::Line<float>::from(*c.start_mp, wp));
+	auto col = find_line_intersections(c.swg, c.swts, c.swls, c.swlis, c.swlods, c.swbs, *c.start_mp, wp, c.cam.scale);
 	std::sort(col.rbegin(), col.rend()); // Avoid deletion of empty cells
 
-	for (size_t i : col) erase(i, c.swts, c.swls, c.swlis);
+	for (size_t i : col)
+	{
+		grid_erase(c.swg, i, c.swts);
+		tile_invalidate(c.tiles, c.regen, c.swts[i].dim);
+		atlas_free(c.atlas, c.swts[i].region);
+		atlas_erase(c.atlas, i, c.swts.size() - 1);
+		journal_erase_stroke(c, i);
+		erase(i, c.swts, c.swls, c.swlis, c.swlods, c.swbs, c.swms);
+	}
+
+	compact_lines(c.swls);
 }
 
 /**
@@ -94,13 +121,15 @@ inline void handle_paint(const SDL_Event &e, const KeyEvent &ke, Window &w, Rend
 
 	case SDL_MOUSEMOTION:
 		if (ke.test(KeyEventMap::MOUSE_LEFT) && stroke_started(c))
-		{
-			continue_stroke(w, r, c.sst, c.ssl, c.ssli);
-			r.refresh();
-		}
+			continue_stroke(c.ssl); // Drawn once per frame in update_paint
 
 		else if (ke.test(KeyEventMap::MOUSE_RIGHT) && erase_started(c))
-			r.refresh();
+		{
+			const auto s  = c.cam.world_screen(*c.start_mp);
+			const auto mp = sdl::mouse_position();
+
+			r.refresh(bounding_rect({ s, mp, mp - mth::Point<int>{ e.motion.xrel, e.motion.yrel } }));
+		}
 
 		break;
 
@@ -108,8 +137,7 @@ inline void handle_paint(const SDL_Event &e, const KeyEvent &ke, Window &w, Rend
 		switch (e.button.button)
 		{
 		case SDL_BUTTON_LEFT:
-			std::tie(c.sst, c.ssl) = start_stroke(w, r, c.ssli);
-			r.refresh();
+			std::tie(c.ssb, c.ssl) = start_stroke(w, r, c.ssli);
 
 			break;
 
@@ -128,9 +156,10 @@ inline void handle_paint(const SDL_Event &e, const KeyEvent &ke, Window &w, Rend
 		case SDL_BUTTON_LEFT:
 			if (stroke_started(c))
 			{
-				c.sst = finalize_stroke(w, r, c.sst, c.ssl, c.ssli);
+				flush_stroke(r, c.ssb, c.ssl, c.ssli);
+				c.sst = finalize_stroke(w, r, c.ssb, c.ssl, c.ssli);
+				r.refresh(c.sst.dim);
 				add_stroke(c);
-				r.refresh();
 			}
 
 			break;
@@ -151,19 +180,56 @@ inline void handle_paint(const SDL_Event &e, const KeyEvent &ke, Window &w, Rend
 	}
 }
 
+/**
+ * @brief Bring visible stroke textures to the camera resolution once zooming settled
+ */
+inline void update_stroke_lod(Renderer &r, CanvasContext &c)
+{
+	if (!c.lod_dirty || c.stroke_render != StrokeRender::TEXTURE || SDL_GetTicks() - c.zoom_tick < LOD_SETTLE)
+		return;
+
+	const auto idx	= grid_query(c.swg, c.swts, visible_area(r, c.cam));
+	const auto done = regen_strokes_lod(r, c.swts, c.swls, c.swlis, c.swlods, idx, c.cam.scale, LOD_BUDGET);
+
+	for (const auto i : done)
+	{
+		atlas_queue(c.atlas, i);
+		r.refresh(c.cam.world_screen(c.swts[i].dim));
+	}
+
+	c.lod_dirty = done.size() == LOD_BUDGET; // Continue next frame
+}
+
+/**
+ * @brief Rasterize the points gathered during this frame
+ */
+inline void update_paint(Renderer &r, CanvasContext &c)
+{
+	if (stroke_started(c))
+		flush_stroke(r, c.ssb, c.ssl, c.ssli);
+
+	update_stroke_lod(r, c);
+	update_tiles(r, c.tiles);
+}
+
 /**
  * @brief Draw the strokes to the window
  */
-inline void draw_strokes(const Renderer &r, CanvasContext &c)
+inline void draw_strokes(Renderer &r, CanvasContext &c)
 {
-	for (const auto &t : c.swts)
+	switch (c.stroke_render)
 	{
-		const auto world = c.cam.world_screen(t.dim);
-		r.draw_texture(t.data, world);
+	case StrokeRender::TILED: draw_tiles(r, c); break;
+
+	case StrokeRender::TEXTURE:
+		draw_world_textures(r, c.cam, c.atlas, c.swts, grid_query(c.swg, c.swts, visible_area(r, c.cam)));
+		break;
+
+	case StrokeRender::VECTOR: draw_meshes(r, c); break;
 	}
 
 	if (stroke_started(c))
-		r.draw_texture(c.sst.data, c.sst.dim);
+		r.draw_texture(c.ssb.tex, c.ssb.area);
 
 	if (c.status == CanvasStatus::PAINTING && erase_started(c))
 	{
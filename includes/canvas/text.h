@@ -1,82 +1,398 @@
 #pragma once
 
+#include <span>
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
 #include "event.h"
+#include "codec.h"
 #include "layout.h"
+#include "atlas.h"
+#include "transform.h"
+#include "text_buffer.h"
+
+/**
+ * @brief Generate the distance field of a glyph into the glyph atlas
+ *
+ * @param r Upload the pixels
+ * @param gc Cache owning the atlas
+ * @param tf Font to rasterize with
+ * @param g Glyph to fill out
+ */
+inline void raster_glyph(Renderer &r, GlyphCache &gc, const TextFont &tf, Glyph &g)
+{
+	const auto t = r.create_image_texture(Renderer::raster_sdf(tf.sdf, utf8_encode(g.ch), SDF_SPREAD));
+
+	g.size	 = r.get_texture_size(t);
+	g.region = atlas_insert(r, gc.atlas, t, { 0, 0, g.size.w, g.size.h });
+
+	if (g.advance == 0) // Not in the font, use the fallback box
+		g.advance = g.size.w - SDF_SPREAD * 2;
+}
+
+/**
+ * @brief Get a glyph, rasterizing it the first time it is used
+ *
+ * @param r Upload the pixels
+ * @param gc Cache to search
+ * @param tf Font to rasterize with
+ * @param ch Code point
+ *
+ * @return Index of the glyph in the cache
+ */
+inline auto get_glyph(Renderer &r, GlyphCache &gc, const TextFont &tf, uint32_t ch) -> uint32_t
+{
+	const auto [g, added] = gc.index.try_emplace(ch, (uint32_t)gc.glyphs.size());
+
+	if (added)
+	{
+		gc.glyphs.push_back({ .ch = ch, .advance = Renderer::glyph_advance(tf.sdf, ch) });
+		raster_glyph(r, gc, tf, gc.glyphs.back());
+	}
+
+	return g->second;
+}
+
+/**
+ * @brief Generate the printable ascii glyphs up front so typing them never waits
+ *
+ * @param r Upload the pixels
+ * @param gc Cache to fill
+ * @param tf Font to rasterize with
+ */
+inline void preload_glyphs(Renderer &r, GlyphCache &gc, const TextFont &tf)
+{
+	for (uint32_t ch = ' '; ch <= '~'; ++ch) get_glyph(r, gc, tf, ch);
+}
+
+/**
+ * @brief Rasterize all known glyphs again after the atlas lost its content
+ *
+ * @param r Upload the pixels
+ * @param gc Cache to reload
+ * @param tf Font to rasterize with
+ */
+inline void reload_glyphs(Renderer &r, GlyphCache &gc, const TextFont &tf)
+{
+	gc.atlas.clear();
+
+	for (auto &g : gc.glyphs) raster_glyph(r, gc, tf, g);
+}
 
 /**
- * @brief Regenerate modified text
+ * @brief Place the glyphs of one paragraph, wrapping at spaces
  *
- * @param r Renderer for creating new text texture
- * @param tf Font used for text
- * @param stxi Text for generating
+ * @param r Rasterize new glyphs
+ * @param gc Glyph cache
+ * @param tf Font of the text
+ * @param s Paragraph without its line break
  *
- * @return Generated texture
+ * @return Laid out paragraph
+ */
+inline auto layout_paragraph(Renderer &r, GlyphCache &gc, const TextFont &tf, std::string_view s) -> TextParagraph
+{
+	TextParagraph p = { .bytes = s.size() };
+
+	int32_t x	  = 0;
+	size_t	line  = 0;			// First quad of the current line
+	size_t	space = SIZE_MAX;	// Quad after the last space of the current line
+
+	for (size_t i = 0; i < s.size();)
+	{
+		const auto n  = std::min(utf8_length(s[i]), s.size() - i);
+		const auto ch = utf8_decode(s.substr(i, n));
+		const auto g  = get_glyph(r, gc, tf, ch);
+		i += n;
+
+		const auto adv = gc.glyphs[g].advance;
+
+		if (x + adv > TEXT_WRAP / SDF_RATIO && p.quads.size() > line)
+		{
+			// Carry the unfinished word over unless it fills the whole line
+			const auto from = space != SIZE_MAX && space > line ? space : p.quads.size();
+			const auto dx	= from < p.quads.size() ? p.quads[from].pos.x : x;
+
+			for (auto q = p.quads.begin() + from; q != p.quads.end(); ++q)
+			{
+				q->pos.x -= dx;
+				q->pos.y += gc.line_skip;
+			}
+
+			x -= dx;
+			line  = from;
+			space = SIZE_MAX;
+			++p.lines;
+		}
+
+		p.quads.push_back({ .glyph = g, .pos = { x, (p.lines - 1) * gc.line_skip } });
+		x += adv;
+
+		if (ch == ' ')
+			space = p.quads.size();
+	}
+
+	for (const auto &q : p.quads) p.width = std::max(p.width, q.pos.x + gc.glyphs[q.glyph].advance);
+
+	return p;
+}
+
+/**
+ * @brief Sum up the size of all paragraphs
  */
-inline auto gen_text(Renderer &r, const TextFont &tf, const WorldTextInfo &stxi, mth::Point<float> loc)
-	-> WorldTexture
+inline auto layout_size(const GlyphCache &gc, const TextLayout &l) -> mth::Dim<int>
 {
-	auto	   t = r.create_text(tf.data, stxi.str.c_str());
-	const auto d = (mth::Dim<float>)r.get_texture_size(t) / stxi.scale; // Target world pos
+	mth::Dim<int> d = { gc.line_skip / 2, 0 }; // Keep empty texts selectable
+
+	for (const auto &p : l.paras)
+	{
+		d.w = std::max(d.w, p.width);
+		d.h += p.lines * gc.line_skip;
+	}
 
-	return WorldTexture{ .dim = { loc.x, loc.y, d.w, d.h }, .data = std::move(t) };
+	return d;
 }
 
 /**
- * @brief Regenerate whole text texture db
+ * @brief Lay out consecutive paragraphs
+ *
+ * @param r Rasterize new glyphs
+ * @param gc Glyph cache
+ * @param tf Font of the text
+ * @param str Paragraphs separated by line breaks
  *
- * @param r Create new text texture
- * @param tf Font for text to take on
- * @param wtxs Texture db to fill out
- * @param wtxis Text information for text
+ * @return One layout per paragraph
  */
-inline void regen_texts(Renderer &r, const TextFont &tf, WorldTextureDB &wtxs, const WorldTextInfoDB &wtxis)
+inline auto layout_paragraphs(Renderer &r, GlyphCache &gc, const TextFont &tf, std::string_view str)
+	-> std::vector<TextParagraph>
 {
-	assert(wtxis.size() == wtxs.size());
+	std::vector<TextParagraph> ps;
 
-	for (size_t i = 0; i < wtxs.size(); ++i)
+	for (size_t b = 0;;)
 	{
-		wtxs[i] = gen_text(r, tf, wtxis[i], wtxs[i].dim.pos());
+		const auto e = std::min(str.find('\n', b), str.size());
+		ps.push_back(layout_paragraph(r, gc, tf, str.substr(b, e - b)));
+
+		if (e == str.size())
+			return ps;
+
+		b = e + 1;
 	}
 }
 
 /**
- * @brief Add a character to the text information
+ * @brief Lay out a whole text
  *
- * @param ch Character to add
- * @param stxi Info to fill out
+ * @param r Rasterize new glyphs
+ * @param gc Glyph cache
+ * @param tf Font of the text
+ * @param b Text to lay out
+ *
+ * @return Laid out text
  */
-inline void add_character(char ch, WorldTextInfo &stxi)
+inline auto layout_text(Renderer &r, GlyphCache &gc, const TextFont &tf, const TextBuffer &b) -> TextLayout
 {
-	stxi.str.push_back(ch);
+	TextLayout l = { .paras = layout_paragraphs(r, gc, tf, text_string(b)) };
+	l.size		 = layout_size(gc, l);
+
+	return l;
 }
 
 /**
- * @brief Remove a character when not empty
- * @param stxi Text info to modify
- * @return If text has no text
+ * @brief Find the paragraph holding a byte
+ *
+ * @param l Layout of the text
+ * @param i Byte of the text
+ *
+ * @return Paragraph index and its first byte
  */
-inline void remove_character(WorldTextInfo &stxi)
+inline auto find_paragraph(const TextLayout &l, size_t i) -> std::pair<size_t, size_t>
 {
-	if (stxi.str.empty())
-		return;
+	size_t p = 0, begin = 0;
 
-	stxi.str.pop_back();
+	for (; p + 1 < l.paras.size() && begin + l.paras[p].bytes < i; ++p) begin += l.paras[p].bytes + 1;
+
+	return { p, begin };
 }
 
 /**
- * @brief Initialize a text texture together with info
+ * @brief Edit the text at the cursor and lay out the touched paragraphs again
+ *
+ * @param r Rasterize new glyphs
+ * @param gc Glyph cache
+ * @param tf Font of the text
+ * @param b Text to edit
+ * @param l Layout to update
+ * @param erase Bytes to remove before the cursor
+ * @param insert Text to insert at the cursor
+ */
+inline void edit_text(Renderer &r, GlyphCache &gc, const TextFont &tf, TextBuffer &b, TextLayout &l, size_t erase,
+					  std::string_view insert)
+{
+	erase = std::min(erase, b.gap);
+
+	auto [last, begin] = find_paragraph(l, b.gap);
+	auto first		   = last;
+
+	while (begin > b.gap - erase) // Erased line breaks join paragraphs
+	{
+		--first;
+		begin -= l.paras[first].bytes + 1;
+	}
+
+	text_erase(b, erase);
+	text_insert(b, insert);
+
+	auto ps = layout_paragraphs(r, gc, tf, text_copy(b, begin, text_line_end(b, b.gap)));
+
+	l.paras.erase(l.paras.begin() + first, l.paras.begin() + last + 1);
+	l.paras.insert(l.paras.begin() + first, std::make_move_iterator(ps.begin()), std::make_move_iterator(ps.end()));
+
+	l.size = layout_size(gc, l);
+}
+
+/**
+ * @brief Get where the cursor is drawn
+ *
+ * @param gc Glyph cache
+ * @param b Text with the cursor
+ * @param l Layout of the text
+ *
+ * @return Top of the cursor in glyph pixels from the text top left
+ */
+inline auto text_caret(const GlyphCache &gc, const TextBuffer &b, const TextLayout &l) -> mth::Point<int32_t>
+{
+	const auto [k, begin] = find_paragraph(l, b.gap);
+
+	int32_t y = 0;
+	for (size_t i = 0; i < k; ++i) y += l.paras[i].lines * gc.line_skip;
+
+	const auto &p = l.paras[k];
+
+	size_t n = 0; // Characters before the cursor
+	for (auto i = begin; i < b.gap; i = text_next(b, i)) ++n;
+
+	if (n < p.quads.size())
+		return { p.quads[n].pos.x, y + p.quads[n].pos.y };
+
+	if (p.quads.empty())
+		return { 0, y };
+
+	const auto &q = p.quads.back();
+	return { q.pos.x + gc.glyphs[q.glyph].advance, y + q.pos.y };
+}
+
+/**
+ * @brief Get the world area of a laid out text
+ */
+inline auto text_dim(mth::Point<float> loc, const TextLayout &l, float scale) -> mth::Rect<float>
+{
+	const auto s = SDF_RATIO / scale;
+	return { loc.x, loc.y, l.size.w * s, l.size.h * s };
+}
+
+/**
+ * @brief Get how often the distance field edge has to be sharpened to span about one screen pixel
+ *
+ * @param cam Camera drawn with
+ * @param scale Camera scale of the text
+ */
+inline auto sdf_steps(const sdl::Camera2D &cam, float scale) -> int
+{
+	const auto px = cam.scale * SDF_RATIO / scale; // Screen pixels per glyph pixel
+	return std::clamp((int)std::lround(std::log2(2.F * SDF_SPREAD * px)), 0, SDF_STEPS_MAX);
+}
+
+/**
+ * @brief Draw texts as distance field glyph quads batched by atlas page
+ *
+ * @param r Draw the glyphs
+ * @param cam Transform to the screen
+ * @param gc Glyph cache
+ * @param wts Text dimensions
+ * @param wtxis Text scales
+ * @param ls Text layouts
+ * @param idx Indices of the texts
+ */
+inline void draw_text_layouts(Renderer &r, const sdl::Camera2D &cam, const GlyphCache &gc, const WorldTextureDB &wts,
+							  const WorldTextInfoDB &wtxis, const TextLayoutDB &ls, std::span<const size_t> idx)
+{
+	// Texts of different scales need their own sharpness, one layer each
+	std::array<std::vector<size_t>, SDF_STEPS_MAX + 1> steps;
+	for (auto i : idx) steps[sdf_steps(cam, wtxis[i].scale)].push_back(i);
+
+	std::vector<std::vector<mth::Rect<int>>>   srcs(gc.atlas.pages.size());
+	std::vector<std::vector<mth::Rect<float>>> worlds(gc.atlas.pages.size()); // Transformed together
+	std::vector<mth::Rect<int>>				   dsts;
+
+	for (int n = 0; n <= SDF_STEPS_MAX; ++n)
+	{
+		if (steps[n].empty())
+			continue;
+
+		for (auto i : steps[n])
+		{
+			const auto o = wts[i].dim.pos();
+			const auto s = SDF_RATIO / wtxis[i].scale;
+
+			int32_t y = 0;
+
+			for (const auto &p : ls[i].paras)
+			{
+				for (const auto &q : p.quads)
+				{
+					const auto &g = gc.glyphs[q.glyph];
+
+					if (g.region.page == -1)
+						continue;
+
+					const mth::Rect<float> w = { o.x + (q.pos.x - SDF_SPREAD) * s, o.y + (y + q.pos.y - SDF_SPREAD) * s,
+												 g.size.w * s, g.size.h * s };
+
+					srcs[g.region.page].push_back(g.region.rect);
+					worlds[g.region.page].push_back(w);
+				}
+
+				y += p.lines * gc.line_skip;
+			}
+		}
+
+		r.begin_layer();
+
+		for (size_t p = 0; p < gc.atlas.pages.size(); ++p)
+			if (!srcs[p].empty())
+			{
+				dsts.resize(worlds[p].size());
+				world_screen_batch(cam, worlds[p], dsts);
+				r.draw_frames_max(gc.atlas.pages[p].data, srcs[p], dsts); // Overlapping spreads must not add up
+
+				srcs[p].clear();
+				worlds[p].clear();
+			}
+
+		r.end_layer(n);
+	}
+}
+
+/**
+ * @brief Initialize an empty text together with its info and layout
  *
  * @param wp Text location
  * @param scale Camera scale to use for rendering
  *
- * @return Text and Info pair
+ * @return Info, dimensions and layout
  */
-inline auto start_new_text(Renderer &r, TextFont &f, mth::Point<float> wp, float scale) -> std::pair<WorldTextInfo, WorldTexture>
+inline auto start_new_text(Renderer &r, GlyphCache &gc, const TextFont &f, mth::Point<float> wp, float scale)
+	-> std::tuple<WorldTextInfo, WorldTexture, TextLayout>
 {
-	WorldTextInfo wtxi = { .str = "", .scale = scale };
-	WorldTexture  wtx  = gen_text(r, f, wtxi, wp);
+	WorldTextInfo wtxi = { .text = {}, .scale = scale };
+	TextLayout	  l	   = layout_text(r, gc, f, wtxi.text);
+	WorldTexture  wtx  = { .dim = text_dim(wp, l, scale) };
 
-	return { std::move(wtxi), std::move(wtx) };
+	return { std::move(wtxi), std::move(wtx), std::move(l) };
 }
 
 inline void start_text_input()
@@ -91,20 +407,3 @@ inline void stop_text_input()
 	SDL_StopTextInput();
 	ctl::print("End text input\n");
 }
-
-/**
- * @brief Add target text to texts
- *
- * @param etxt Text texture to move
- * @param etxi Text info to move
- * @param wtxts Text texture db to push to
- * @param wtxis Text info db to push to
- */
-inline void flush_text(WorldTexture &etxt, WorldTextInfo &etxi, WorldTextureDB &wtxts, WorldTextInfoDB &wtxis)
-{
-	if (etxt.data == nullptr)
-		return;
-
-	wtxts.push_back(std::move(etxt));
-	wtxis.push_back(std::move(etxi));
-}
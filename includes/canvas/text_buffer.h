@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+
+#include "layout.h"
+
+using namespace ctl;
+
+/**
+ * @brief Create a buffer with the cursor at the end of a text
+ */
+inline auto text_buffer(std::string_view s) -> TextBuffer
+{
+	return { .data = { s.begin(), s.end() }, .gap = s.size(), .gap_end = s.size() };
+}
+
+/**
+ * @brief Get the byte count of the text
+ */
+inline auto text_size(const TextBuffer &b) -> size_t
+{
+	return b.data.size() - (b.gap_end - b.gap);
+}
+
+/**
+ * @brief Get a byte of the text
+ */
+inline auto text_at(const TextBuffer &b, size_t i) -> char
+{
+	return i < b.gap ? b.data[i] : b.data[i + b.gap_end - b.gap];
+}
+
+/**
+ * @brief Copy a byte range of the text
+ *
+ * @param b Buffer to read
+ * @param from First byte
+ * @param to Byte after the last
+ */
+inline auto text_copy(const TextBuffer &b, size_t from, size_t to) -> std::string
+{
+	std::string s;
+	s.reserve(to - from);
+
+	if (from < b.gap)
+		s.append(b.data.begin() + from, b.data.begin() + std::min(to, b.gap));
+
+	if (to > b.gap)
+	{
+		const auto d = b.gap_end - b.gap;
+		s.append(b.data.begin() + std::max(from, b.gap) + d, b.data.begin() + to + d);
+	}
+
+	return s;
+}
+
+/**
+ * @brief Copy the whole text
+ */
+inline auto text_string(const TextBuffer &b) -> std::string
+{
+	return text_copy(b, 0, text_size(b));
+}
+
+/**
+ * @brief Move the cursor by moving the gap
+ *
+ * @param b Buffer to edit
+ * @param pos New cursor byte, clamped to the text
+ */
+inline void text_move(TextBuffer &b, size_t pos)
+{
+	pos = std::min(pos, text_size(b));
+
+	if (pos < b.gap)
+	{
+		const auto n = b.gap - pos;
+		std::memmove(b.data.data() + b.gap_end - n, b.data.data() + pos, n);
+
+		b.gap_end -= n;
+		b.gap = pos;
+	}
+	else if (pos > b.gap)
+	{
+		const auto n = pos - b.gap;
+		std::memmove(b.data.data() + b.gap, b.data.data() + b.gap_end, n);
+
+		b.gap_end += n;
+		b.gap = pos;
+	}
+}
+
+/**
+ * @brief Insert text at the cursor, growing the gap when full
+ */
+inline void text_insert(TextBuffer &b, std::string_view s)
+{
+	if (b.gap_end - b.gap < s.size())
+	{
+		const auto grow = std::max(s.size(), b.data.size()) + 16;
+		b.data.insert(b.data.begin() + b.gap_end, grow, '\0');
+		b.gap_end += grow;
+	}
+
+	std::memcpy(b.data.data() + b.gap, s.data(), s.size());
+	b.gap += s.size();
+}
+
+/**
+ * @brief Remove bytes before the cursor
+ */
+inline void text_erase(TextBuffer &b, size_t n)
+{
+	b.gap -= std::min(n, b.gap);
+}
+
+/**
+ * @brief Get the start of the character before a byte
+ */
+inline auto text_prev(const TextBuffer &b, size_t i) -> size_t
+{
+	if (i == 0)
+		return 0;
+
+	do --i;
+	while (i > 0 && ((unsigned char)text_at(b, i) & 0xC0) == 0x80); // Skip continuation bytes
+
+	return i;
+}
+
+/**
+ * @brief Get the start of the character after a byte
+ */
+inline auto text_next(const TextBuffer &b, size_t i) -> size_t
+{
+	const auto n = text_size(b);
+
+	if (i >= n)
+		return n;
+
+	do ++i;
+	while (i < n && ((unsigned char)text_at(b, i) & 0xC0) == 0x80);
+
+	return i;
+}
+
+/**
+ * @brief Get the start of the paragraph holding a byte
+ */
+inline auto text_line_begin(const TextBuffer &b, size_t i) -> size_t
+{
+	while (i > 0 && text_at(b, i - 1) != '\n') --i;
+	return i;
+}
+
+/**
+ * @brief Get the line break ending the paragraph holding a byte (or the text end)
+ */
+inline auto text_line_end(const TextBuffer &b, size_t i) -> size_t
+{
+	const auto n = text_size(b);
+
+	while (i < n && text_at(b, i) != '\n') ++i;
+	return i;
+}
@@ -0,0 +1,344 @@
+#pragma once
+
+#include <span>
+#include <cmath>
+#include <algorithm>
+
+#include <CustomLibrary/Collider.h>
+
+#include "layout.h"
+#include "spatial.h"
+#include "stroke.h"
+
+using namespace ctl;
+
+/**
+ * @brief Get the discrete zoom level for a camera scale (rounded up to stay sharp)
+ */
+inline auto tile_level(float scale) -> int
+{
+	return (int)std::ceil(std::log2(scale));
+}
+
+/**
+ * @brief Get the camera scale a level is rasterized at
+ */
+inline auto tile_scale(int level) -> float
+{
+	return std::ldexp(1.F, level);
+}
+
+/**
+ * @brief Get the world size covered by a tile of a level
+ */
+inline auto tile_world_size(int level) -> float
+{
+	return TILE_SIZE / tile_scale(level);
+}
+
+/**
+ * @brief Pack a tile location into a map key
+ */
+constexpr auto tile_key(int level, int32_t x, int32_t y) -> uint64_t
+{
+	return ((uint64_t)(uint8_t)level << 56) | (((uint64_t)x & 0xFFFFFFF) << 28) | ((uint64_t)y & 0xFFFFFFF);
+}
+
+/**
+ * @brief Get the world area covered by a tile
+ */
+inline auto tile_area(int level, int32_t x, int32_t y) -> mth::Rect<float>
+{
+	const auto tw = tile_world_size(level);
+	return { x * tw, y * tw, tw, tw };
+}
+
+/**
+ * @brief Queue the rasterization of all strokes inside a tile
+ *
+ * @param p Pool to queue to
+ * @param c Get the stroke dbs and index
+ * @param level Zoom level of the tile
+ * @param x Tile x position
+ * @param y Tile y position
+ *
+ * @return Ticket of the job or 0 if no stroke is inside
+ */
+inline auto queue_tile(RegenPool &p, SaveState &c, int level, int32_t x, int32_t y) -> uint64_t
+{
+	const auto area = tile_area(level, x, y);
+	const auto idx	= grid_query(c.swg, c.swts, area);
+
+	if (idx.empty())
+		return 0;
+
+	sdl::Camera2D cam{ .loc = area.pos(), .scale = tile_scale(level) };
+
+	TileJob j = { .ticket = 0, .key = tile_key(level, x, y) };
+	j.strokes.reserve(idx.size());
+
+	for (size_t i : idx) // Transformed here, the workers only get copies
+	{
+		const auto &wt	= c.swts[i];
+		const auto	ps	= lod_points(c.swlods, c.swls, c.swlis, i, cam.scale);
+		const auto &wli = c.swlis[i];
+
+		auto &ts = j.strokes.emplace_back(
+			TileStroke{ .color = wli.color, .width = wli.radius / wli.scale * cam.scale, .points = {} });
+
+		ts.points.resize(ps.size());
+		world_screen_batch(cam, ps, ts.points, wt.dim.pos());
+	}
+
+	std::lock_guard l(p.m);
+
+	std::erase_if(p.tile_jobs, [&j](const TileJob &o) { return o.key == j.key; }); // Replaced
+
+	j.ticket = p.next_ticket++;
+	p.tile_jobs.push_back(std::move(j));
+	p.cv.notify_one();
+
+	return p.tile_jobs.back().ticket;
+}
+
+/**
+ * @brief Upload a budgeted amount of rasterized tiles
+ *
+ * @param r Upload the pixels & mark damage
+ * @param c Get the tile cache to fill
+ */
+inline void apply_tiles(Renderer &r, CanvasContext &c)
+{
+	std::vector<TileResult> done;
+
+	{
+		std::lock_guard l(c.regen.m);
+
+		const auto n = std::min(c.regen.tiles_done.size(), (size_t)REGEN_UPLOADS);
+		std::move(c.regen.tiles_done.end() - n, c.regen.tiles_done.end(), std::back_inserter(done));
+		c.regen.tiles_done.erase(c.regen.tiles_done.end() - n, c.regen.tiles_done.end());
+	}
+
+	for (auto &res : done)
+	{
+		const auto t = c.tiles.tiles.find(res.key);
+
+		if (t == c.tiles.tiles.end() || t->second.job != res.ticket) // Invalidated or evicted meanwhile
+			continue;
+
+		auto &tl = t->second;
+
+		tl.data = r.create_image_texture(res.img);
+		tl.job	= 0;
+
+		r.refresh(c.cam.world_screen(tile_area(tl.level, tl.pos.x, tl.pos.y)));
+	}
+}
+
+/**
+ * @brief Drop the queued jobs of tiles no longer waiting for them
+ *
+ * @param p Pool to remove the jobs from
+ * @param keys Tiles to cancel
+ */
+inline void tile_cancel(RegenPool &p, std::span<const uint64_t> keys)
+{
+	if (keys.empty())
+		return;
+
+	std::lock_guard l(p.m);
+
+	std::erase_if(p.tile_jobs,
+				  [keys](const TileJob &j) { return std::find(keys.begin(), keys.end(), j.key) != keys.end(); });
+}
+
+/**
+ * @brief Drop all cached tiles of every level overlapping a world area
+ *
+ * @param tc Cache to invalidate
+ * @param p Pool to cancel their jobs in
+ * @param wr Modified world area
+ */
+inline void tile_invalidate(TileCache &tc, RegenPool &p, const mth::Rect<float> &wr)
+{
+	std::vector<uint64_t> keys;
+
+	std::erase_if(tc.tiles,
+				  [&wr, &keys](const auto &kt)
+				  {
+					  const auto &t = kt.second;
+
+					  if (!mth::collision(tile_area(t.level, t.pos.x, t.pos.y), wr))
+						  return false;
+
+					  if (t.job != 0)
+						  keys.push_back(kt.first);
+
+					  return true;
+				  });
+
+	tile_cancel(p, keys);
+}
+
+/**
+ * @brief Drop all tiles and their jobs
+ *
+ * @param tc Cache to clear
+ * @param p Pool to cancel the jobs in
+ */
+inline void drop_tiles(TileCache &tc, RegenPool &p)
+{
+	tc.clear();
+
+	std::lock_guard l(p.m);
+
+	p.tile_jobs.clear();
+	p.tiles_done.clear();
+}
+
+/**
+ * @brief Free the least recently drawn tiles above the cache limit
+ *
+ * @param tc Cache to shrink
+ * @param p Pool to cancel the jobs of evicted tiles in
+ */
+inline void tile_evict(TileCache &tc, RegenPool &p)
+{
+	std::vector<uint64_t> keys;
+
+	while (tc.tiles.size() > TILE_CACHE_MAX)
+	{
+		const auto old = std::min_element(tc.tiles.begin(), tc.tiles.end(),
+										  [](const auto &a, const auto &b) { return a.second.used < b.second.used; });
+
+		if (old->second.used == tc.frame) // Everything is on screen
+			break;
+
+		if (old->second.job != 0)
+			keys.push_back(old->first);
+
+		tc.tiles.erase(old);
+	}
+
+	tile_cancel(p, keys);
+}
+
+/**
+ * @brief Advance the tile frame and draw the tiles skipped while dragging once it settled
+ *
+ * @param r Mark the screen to be redrawn
+ * @param tc Tile cache to update
+ */
+inline void update_tiles(Renderer &r, TileCache &tc)
+{
+	++tc.frame; // Once per frame, tiles might be drawn for several damaged areas
+
+	if (tc.held && SDL_GetTicks() - tc.drag_tick >= TILE_SETTLE)
+	{
+		tc.held = false;
+		r.refresh();
+	}
+}
+
+/**
+ * @brief Stand in for a rasterizing tile with a coarser or finer cached one
+ *
+ * @param r Draw the tile
+ * @param tc Cache to look in
+ * @param level Zoom level of the missing tile
+ * @param x Tile x position
+ * @param y Tile y position
+ * @param dst Screen area of the missing tile
+ */
+inline void draw_tile_fallback(const Renderer &r, TileCache &tc, int level, int32_t x, int32_t y,
+							   mth::Rect<int> dst)
+{
+	for (int d = 1; d <= TILE_FALLBACK; ++d) // Part of a coarser tile, blurry until replaced
+	{
+		const auto t = tc.tiles.find(tile_key(level - d, x >> d, y >> d));
+
+		if (t == tc.tiles.end() || !t->second.data)
+			continue;
+
+		const auto s = TILE_SIZE >> d;
+
+		t->second.used = tc.frame;
+		r.draw_frame(t->second.data, { (x - (x >> d << d)) * s, (y - (y >> d << d)) * s, s, s }, dst);
+		return;
+	}
+
+	for (int i = 0; i < 4; ++i) // The four finer tiles left from zooming out
+	{
+		const auto t = tc.tiles.find(tile_key(level + 1, x * 2 + i % 2, y * 2 + i / 2));
+
+		if (t == tc.tiles.end() || !t->second.data)
+			continue;
+
+		const auto x1 = dst.x + dst.w * (i % 2) / 2;
+		const auto y1 = dst.y + dst.h * (i / 2) / 2;
+		const auto x2 = dst.x + dst.w * (i % 2 + 1) / 2;
+		const auto y2 = dst.y + dst.h * (i / 2 + 1) / 2;
+
+		t->second.used = tc.frame;
+		r.draw_texture(t->second.data, { x1, y1, x2 - x1, y2 - y1 });
+	}
+}
+
+/**
+ * @brief Compose the visible strokes from cached tiles
+ *
+ * @param r Draw the tiles
+ * @param c Get camera, strokes, tile cache & workers to rasterize missing tiles
+ */
+inline void draw_tiles(Renderer &r, CanvasContext &c)
+{
+	auto &tc = c.tiles;
+
+	const auto hold	 = SDL_GetTicks() - tc.drag_tick < TILE_SETTLE; // Each motion would queue them again
+	const auto level = tile_level(c.cam.scale);
+	const auto tw	 = tile_world_size(level);
+	const auto va	 = visible_area(r, c.cam);
+
+	const auto x1 = (int32_t)std::floor(va.x / tw);
+	const auto y1 = (int32_t)std::floor(va.y / tw);
+	const auto x2 = (int32_t)std::floor((va.x + va.w) / tw);
+	const auto y2 = (int32_t)std::floor((va.y + va.h) / tw);
+
+	for (auto y = y1; y <= y2; ++y)
+		for (auto x = x1; x <= x2; ++x)
+		{
+			auto t = tc.tiles.find(tile_key(level, x, y));
+
+			// Use the corners so neighbouring tiles share their edges
+			const auto p1 = c.cam.world_screen(mth::Point<float>{ x * tw, y * tw });
+			const auto p2 = c.cam.world_screen(mth::Point<float>{ (x + 1) * tw, (y + 1) * tw });
+
+			const mth::Rect<int> dst = { p1.x, p1.y, p2.x - p1.x, p2.y - p1.y };
+
+			if (t == tc.tiles.end() && hold)
+			{
+				tc.held = true;
+				draw_tile_fallback(r, tc, level, x, y, dst);
+
+				continue;
+			}
+
+			if (t == tc.tiles.end())
+				t = tc.tiles
+						.emplace(tile_key(level, x, y), Tile{ .level = level,
+															  .pos	 = { x, y },
+															  .used	 = 0,
+															  .data	 = nullptr,
+															  .job	 = queue_tile(c.regen, c, level, x, y) })
+						.first;
+
+			t->second.used = tc.frame;
+
+			if (t->second.data)
+				r.draw_texture(t->second.data, dst);
+			else if (t->second.job != 0)
+				draw_tile_fallback(r, tc, level, x, y, dst);
+		}
+
+	tile_evict(tc, c.regen);
+}
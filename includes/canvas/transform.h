@@ -0,0 +1,178 @@
+#pragma once
+
+#include <span>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include <CustomLibrary/SDL/All.h>
+
+#include "layout.h"
+
+using namespace ctl;
+
+static_assert(sizeof(mth::Point<float>) == 8 && sizeof(mth::Point<int>) == 8, "Points are read as float pairs");
+static_assert(sizeof(mth::Rect<float>) == 16 && sizeof(mth::Rect<int>) == 16, "Rects are read as float quads");
+
+/**
+ * @brief Transform world points to the screen
+ *
+ * @param cam Camera to transform with
+ * @param ps Points relative to origin
+ * @param out Screen points (same size)
+ * @param origin World position the points are relative to
+ */
+inline void world_screen_batch(const sdl::Camera2D &cam, std::span<const mth::Point<float>> ps,
+							   std::span<mth::Point<int>> out, mth::Point<float> origin = { 0.F, 0.F })
+{
+	assert(ps.size() == out.size() && "Output not same length.");
+
+	const auto ox = origin.x - cam.loc.x;
+	const auto oy = origin.y - cam.loc.y;
+
+	size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+	const auto o = _mm_setr_ps(ox, oy, ox, oy);
+	const auto s = _mm_set1_ps(cam.scale);
+
+	const auto *src = reinterpret_cast<const float *>(ps.data());
+	auto	   *dst = reinterpret_cast<int *>(out.data());
+
+	for (; i + 2 <= ps.size(); i += 2) // Two points per register
+	{
+		const auto v = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(src + i * 2), o), s);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 2), _mm_cvttps_epi32(v));
+	}
+#endif
+
+	for (; i < ps.size(); ++i)
+		out[i] = { (int)((ps[i].x + ox) * cam.scale), (int)((ps[i].y + oy) * cam.scale) };
+}
+
+/**
+ * @brief Transform quantized points to the screen, decoding the moves on the way
+ *
+ * @param cam Camera to transform with
+ * @param ps Points relative to origin
+ * @param out Screen points (same size)
+ * @param origin World position the points are relative to
+ */
+inline void world_screen_batch(const sdl::Camera2D &cam, const LinePoints &ps, std::span<mth::Point<int>> out,
+							   mth::Point<float> origin = { 0.F, 0.F })
+{
+	assert(ps.size() == out.size() && "Output not same length.");
+
+	const auto ox = origin.x - cam.loc.x;
+	const auto oy = origin.y - cam.loc.y;
+
+	int32_t x = ps.x, y = ps.y;
+
+	for (size_t i = 0; i < ps.size(); ++i) // The running sums keep this sequential
+	{
+		x += ps.data[i].dx;
+		y += ps.data[i].dy;
+
+		out[i] = { (int)(((float)x * ps.step + ox) * cam.scale), (int)(((float)y * ps.step + oy) * cam.scale) };
+	}
+}
+
+/**
+ * @brief Transform world points to the screen without rounding
+ *
+ * @param cam Camera to transform with
+ * @param ps Points relative to origin
+ * @param out Screen points (same size)
+ * @param origin World position the points are relative to
+ */
+inline void world_screen_batch(const sdl::Camera2D &cam, std::span<const mth::Point<float>> ps,
+							   std::span<mth::Point<float>> out, mth::Point<float> origin = { 0.F, 0.F })
+{
+	assert(ps.size() == out.size() && "Output not same length.");
+
+	const auto ox = origin.x - cam.loc.x;
+	const auto oy = origin.y - cam.loc.y;
+
+	size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+	const auto o = _mm_setr_ps(ox, oy, ox, oy);
+	const auto s = _mm_set1_ps(cam.scale);
+
+	const auto *src = reinterpret_cast<const float *>(ps.data());
+	auto	   *dst = reinterpret_cast<float *>(out.data());
+
+	for (; i + 2 <= ps.size(); i += 2)
+		_mm_storeu_ps(dst + i * 2, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(src + i * 2), o), s));
+#endif
+
+	for (; i < ps.size(); ++i) out[i] = { (ps[i].x + ox) * cam.scale, (ps[i].y + oy) * cam.scale };
+}
+
+/**
+ * @brief Transform screen points to the world
+ *
+ * @param cam Camera to transform with
+ * @param ps Screen points
+ * @param out World points relative to origin (same size)
+ * @param origin World position to make the points relative to
+ */
+inline void screen_world_batch(const sdl::Camera2D &cam, std::span<const mth::Point<int>> ps,
+							   std::span<mth::Point<float>> out, mth::Point<float> origin = { 0.F, 0.F })
+{
+	assert(ps.size() == out.size() && "Output not same length.");
+
+	const auto ox = cam.loc.x - origin.x;
+	const auto oy = cam.loc.y - origin.y;
+
+	size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+	const auto o = _mm_setr_ps(ox, oy, ox, oy);
+	const auto s = _mm_set1_ps(cam.scale);
+
+	const auto *src = reinterpret_cast<const int *>(ps.data());
+	auto	   *dst = reinterpret_cast<float *>(out.data());
+
+	for (; i + 2 <= ps.size(); i += 2)
+	{
+		const auto v = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2)));
+		_mm_storeu_ps(dst + i * 2, _mm_add_ps(_mm_div_ps(v, s), o));
+	}
+#endif
+
+	for (; i < ps.size(); ++i) out[i] = { (float)ps[i].x / cam.scale + ox, (float)ps[i].y / cam.scale + oy };
+}
+
+/**
+ * @brief Transform world rects to the screen
+ *
+ * @param cam Camera to transform with
+ * @param rs World rects
+ * @param out Screen rects (same size)
+ */
+inline void world_screen_batch(const sdl::Camera2D &cam, std::span<const mth::Rect<float>> rs,
+							   std::span<mth::Rect<int>> out)
+{
+	assert(rs.size() == out.size() && "Output not same length.");
+
+	size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+	const auto o = _mm_setr_ps(cam.loc.x, cam.loc.y, 0.F, 0.F); // Sizes only scale
+	const auto s = _mm_set1_ps(cam.scale);
+
+	const auto *src = reinterpret_cast<const float *>(rs.data());
+	auto	   *dst = reinterpret_cast<int *>(out.data());
+
+	for (; i < rs.size(); ++i) // One rect per register
+	{
+		const auto v = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(src + i * 4), o), s);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), _mm_cvttps_epi32(v));
+	}
+#endif
+
+	for (; i < rs.size(); ++i) out[i] = cam.world_screen(rs[i]);
+}
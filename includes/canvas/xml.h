@@ -0,0 +1,353 @@
+#pragma once
+
+#include <cctype>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+
+#include "codec.h"
+
+using namespace ctl;
+
+static constexpr size_t XML_BUFFER = 1 << 16; // Bytes written at once
+
+// -----------------------------------------------------------------------------
+// Writing
+// -----------------------------------------------------------------------------
+
+struct XmlWriter
+{
+	std::ofstream f;
+	std::string	  buf;
+};
+
+/**
+ * @brief Write out the buffered bytes
+ */
+inline void xml_flush(XmlWriter &w)
+{
+	if (!w.f.write(w.buf.data(), (std::streamsize)w.buf.size()))
+		throw std::runtime_error("Could not write the file.");
+
+	w.buf.clear();
+}
+
+/**
+ * @brief Open a file for writing with the xml declaration
+ */
+inline auto xml_writer(const char *filename) -> XmlWriter
+{
+	XmlWriter w = { .f = std::ofstream(filename, std::ios::binary) };
+
+	if (!w.f)
+		throw std::runtime_error("Could not open the file.");
+
+	w.buf.reserve(XML_BUFFER + 256);
+	w.buf = "<?xml version=\"1.0\"?>";
+
+	return w;
+}
+
+/**
+ * @brief Start an element tag on its own line
+ *
+ * @param w Writer
+ * @param depth Indentation
+ * @param name Element name
+ */
+inline void xml_begin(XmlWriter &w, int depth, std::string_view name)
+{
+	if (w.buf.size() > XML_BUFFER)
+		xml_flush(w);
+
+	w.buf += '\n';
+	w.buf.append(depth, '\t');
+	w.buf += '<';
+	w.buf += name;
+}
+
+/**
+ * @brief Close a start tag, as empty element if it has no children
+ */
+inline void xml_begin_end(XmlWriter &w, bool empty)
+{
+	w.buf += empty ? " />" : ">";
+}
+
+/**
+ * @brief Write an end tag on its own line
+ */
+inline void xml_end(XmlWriter &w, int depth, std::string_view name)
+{
+	w.buf += '\n';
+	w.buf.append(depth, '\t');
+	w.buf += "</";
+	w.buf += name;
+	w.buf += '>';
+}
+
+/**
+ * @brief Write a number attribute (shortest form that reads back the same)
+ */
+template<typename T>
+inline void xml_attribute(XmlWriter &w, std::string_view name, T v)
+{
+	char b[32];
+
+	w.buf += ' ';
+	w.buf += name;
+	w.buf += "=\"";
+	w.buf.append(b, std::to_chars(b, b + sizeof b, v).ptr);
+	w.buf += '"';
+}
+
+/**
+ * @brief Write an escaped string attribute
+ */
+inline void xml_attribute(XmlWriter &w, std::string_view name, std::string_view v)
+{
+	w.buf += ' ';
+	w.buf += name;
+	w.buf += "=\"";
+
+	for (const auto ch : v)
+		switch (ch)
+		{
+		case '&': w.buf += "&amp;"; break;
+		case '<': w.buf += "&lt;"; break;
+		case '>': w.buf += "&gt;"; break;
+		case '"': w.buf += "&quot;"; break;
+		case '\n': w.buf += "&#10;"; break; // Raw whitespace is read back as spaces
+		case '\r': w.buf += "&#13;"; break;
+		case '\t': w.buf += "&#9;"; break;
+		default: w.buf += ch;
+		}
+
+	w.buf += '"';
+
+	if (w.buf.size() > XML_BUFFER)
+		xml_flush(w);
+}
+
+// -----------------------------------------------------------------------------
+// Reading
+// -----------------------------------------------------------------------------
+
+struct XmlAttribute
+{
+	std::string name, value;
+};
+
+struct XmlReader
+{
+	std::ifstream f;
+
+	std::string				  name;			 // Of the current tag
+	std::vector<XmlAttribute> attrs;		 // Reused, only the first n are set
+	size_t					  n		= 0;
+	bool					  end	= false; // End tag
+	bool					  empty = false; // Start tag without children
+};
+
+/**
+ * @brief Open a file for reading tags
+ */
+inline auto xml_reader(const char *filename) -> XmlReader
+{
+	XmlReader r = { .f = std::ifstream(filename, std::ios::binary) };
+
+	if (!r.f)
+		throw std::runtime_error("Could not open the file.");
+
+	return r;
+}
+
+/**
+ * @brief Read a character or throw at the end of the file
+ */
+inline auto xml_get(XmlReader &r) -> char
+{
+	const auto c = r.f.rdbuf()->sbumpc();
+
+	if (c == std::char_traits<char>::eof())
+		throw std::runtime_error("The xml ends inside a tag.");
+
+	return (char)c;
+}
+
+/**
+ * @brief Skip until after a terminator
+ */
+inline void xml_skip(XmlReader &r, std::string_view term)
+{
+	std::string t; // Last read characters
+
+	while (!t.ends_with(term))
+	{
+		if (t.size() == term.size())
+			t.erase(0, 1);
+
+		t += xml_get(r);
+	}
+}
+
+/**
+ * @brief Decode an entity after its '&'
+ */
+inline void xml_entity(XmlReader &r, std::string &out)
+{
+	char   b[12];
+	size_t n = 0;
+
+	for (char c = xml_get(r); c != ';'; c = xml_get(r))
+		if (n == sizeof b)
+			throw std::runtime_error("An xml entity is too long.");
+		else
+			b[n++] = c;
+
+	const auto e = std::string_view(b, n);
+
+	if (e == "amp") out += '&';
+	else if (e == "lt") out += '<';
+	else if (e == "gt") out += '>';
+	else if (e == "quot") out += '"';
+	else if (e == "apos") out += '\'';
+	else if (e.starts_with('#'))
+	{
+		uint32_t   cp  = 0;
+		const auto hex = e.size() > 1 && e[1] == 'x';
+		std::from_chars(e.data() + (hex ? 2 : 1), e.data() + e.size(), cp, hex ? 16 : 10);
+
+		out += utf8_encode(cp);
+	}
+	else
+		throw std::runtime_error("Unknown xml entity.");
+}
+
+/**
+ * @brief Advance to the next start or end tag, skipping text, comments and declarations
+ *
+ * @param r Reader to advance
+ *
+ * @return False at the end of the file
+ */
+inline auto xml_next(XmlReader &r) -> bool
+{
+	auto *in = r.f.rdbuf();
+
+	while (true)
+	{
+		int c;
+		while ((c = in->sbumpc()) != '<')
+			if (c == std::char_traits<char>::eof())
+				return false;
+
+		auto ch = xml_get(r);
+
+		if (ch == '?')
+		{
+			xml_skip(r, "?>");
+			continue;
+		}
+
+		if (ch == '!')
+		{
+			xml_skip(r, in->sgetc() == '-' ? "-->" : ">");
+			continue;
+		}
+
+		r.end	= ch == '/';
+		r.empty = false;
+		r.n		= 0;
+		r.name.clear();
+
+		if (r.end)
+			ch = xml_get(r);
+
+		for (; !std::isspace((unsigned char)ch) && ch != '>' && ch != '/'; ch = xml_get(r)) r.name += ch;
+
+		while (true)
+		{
+			while (std::isspace((unsigned char)ch)) ch = xml_get(r);
+
+			if (ch == '>')
+				return true;
+
+			if (ch == '/')
+			{
+				r.empty = true;
+				xml_skip(r, ">");
+
+				return true;
+			}
+
+			if (r.n == r.attrs.size())
+				r.attrs.emplace_back();
+
+			auto &a = r.attrs[r.n++];
+			a.name.clear();
+			a.value.clear();
+
+			for (; ch != '=' && !std::isspace((unsigned char)ch); ch = xml_get(r)) a.name += ch;
+			while (ch != '=') ch = xml_get(r);
+
+			do ch = xml_get(r);
+			while (std::isspace((unsigned char)ch));
+
+			if (ch != '"' && ch != '\'')
+				throw std::runtime_error("An xml attribute is not quoted.");
+
+			for (const auto q = ch; (ch = xml_get(r)) != q;)
+				if (ch == '&')
+					xml_entity(r, a.value);
+				else
+					a.value += std::isspace((unsigned char)ch) ? ' ' : ch; // Attribute whitespace normalization
+
+			ch = xml_get(r);
+		}
+	}
+}
+
+/**
+ * @brief Find an attribute of the current tag
+ *
+ * @return Value or nullptr if missing
+ */
+inline auto xml_find(const XmlReader &r, std::string_view name) -> const std::string *
+{
+	for (size_t i = 0; i < r.n; ++i)
+		if (r.attrs[i].name == name)
+			return &r.attrs[i].value;
+
+	return nullptr;
+}
+
+/**
+ * @brief Read attributes of the current tag as numbers
+ *
+ * @param r Reader on the tag
+ * @param names Attributes to read
+ * @param out Values in the order of names
+ *
+ * @return False if one is missing or not a number
+ */
+template<typename... T>
+inline auto xml_numbers(const XmlReader &r, std::initializer_list<std::string_view> names, T &...out) -> bool
+{
+	auto n	= names.begin();
+	bool ok = true;
+
+	const auto read = [&](auto &v)
+	{
+		const auto *s = xml_find(r, *n++);
+		ok			  = ok && s != nullptr && std::from_chars(s->data(), s->data() + s->size(), v).ec == std::errc();
+	};
+
+	(read(out), ...);
+
+	return ok;
+}
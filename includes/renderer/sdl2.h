@@ -1,7 +1,13 @@
 #pragma once
 
+#include <cmath>
 #include <cstring>
 #include <span>
+#include <limits>
+#include <string>
+#include <vector>
+#include <optional>
+#include <algorithm>
 
 #include <SDL.h>
 #include <SDL_ttf.h>
@@ -34,10 +40,16 @@ using CairoSurface = std::unique_ptr<cairo_surface_t, _CairoSurfaceDeleter>;
 struct RendererContext
 {
 	sdl::Renderer r;
-	bool		  refresh = true;
+	bool		  refresh = true; // Redraw everything
+
+	sdl::Texture				back;	// Persistent frame kept between presents
+	sdl::Texture				layer;	// Offscreen alpha for distance field text
+	std::vector<mth::Rect<int>> damage; // Screen areas to redraw
+	std::optional<mth::Rect<int>> clip; // Area being redrawn
 
 	CairoContext cxt;
 	CairoSurface surf;
+	cairo_t		*pen = nullptr; // Context the strokes are drawn with
 };
 
 class Renderer
@@ -51,6 +63,21 @@ public:
 	using CacheTexture = sdl::Texture;
 	using Texture	   = sdl::Texture;
 	using Font		   = sdl::Font;
+	using Image		   = sdl::Surface; // Cpu pixels, safe to create outside of the render thread
+
+	static constexpr bool GEOMETRY = SDL_VERSION_ATLEAST(2, 0, 18); // draw_mesh is available
+
+	static constexpr auto DAMAGE_RECTS = 4;	   // Separate areas redrawn per frame, more get merged
+	static constexpr auto DAMAGE_UNION = 0.5F; // Share of the screen above which the union is redrawn once
+
+	struct StrokeBuffer
+	{
+		mth::Rect<int> area; // Screen area covered
+
+		CairoSurface surf;
+		CairoContext cxt;
+		CacheTexture tex;
+	};
 
 	void init(SDL_Window *win)
 	{
@@ -67,31 +94,70 @@ public:
 		c.refresh = true;
 	}
 
+	void refresh(mth::Rect<int> area)
+	{
+		// Pad for antialiasing and outlines
+		c.damage.push_back({ area.x - 2, area.y - 2, area.w + 4, area.h + 4 });
+	}
+
 	template<typename T>
 	requires std::is_invocable_v<T>
 	void render(T &&draws)
 	{
-		if (!c.refresh)
+		if (!c.refresh && c.damage.empty())
 			return;
 
-		c.refresh = false;
-
 		SDL_SetRenderTarget(c.r.get(), nullptr);
+		_fit_back_buffer();
+
+		const auto areas = c.refresh ? std::vector<mth::Rect<int>>{} : _damage_areas();
+		const auto full	 = c.refresh;
+
+		c.refresh = false;
+		c.damage.clear();
 
+		SDL_SetRenderTarget(c.r.get(), c.back.get());
 		SDL_SetRenderDrawColor(c.r.get(), sdl::WHITE.r, sdl::WHITE.g, sdl::WHITE.b, sdl::WHITE.a);
-		SDL_RenderClear(c.r.get());
 
-		draws();
+		if (full)
+		{
+			SDL_RenderClear(c.r.get());
+			draws();
+		}
+
+		for (const auto &a : areas) // Each drawn on its own, culled to its area
+		{
+			c.clip = a;
+
+			SDL_RenderSetClipRect(c.r.get(), &sdl::to_rect(a));
+			SDL_RenderFillRect(c.r.get(), &sdl::to_rect(a));
+
+			draws();
+		}
+
+		SDL_RenderSetClipRect(c.r.get(), nullptr);
+		c.clip.reset();
 
+		SDL_SetRenderTarget(c.r.get(), nullptr);
+		SDL_RenderCopy(c.r.get(), c.back.get(), nullptr, nullptr);
 		SDL_RenderPresent(c.r.get());
 	}
 
+	auto get_draw_area() const -> mth::Rect<int>
+	{
+		if (c.clip)
+			return *c.clip;
+
+		const auto s = get_output_size();
+		return { 0, 0, s.w, s.h };
+	}
+
 	void set_render_target(const Texture &t)
 	{
 		ASSERT(SDL_SetRenderTarget(c.r.get(), t.get()) == 0, SDL_GetError());
 	}
 
-	auto get_texture_size(const Texture &t) const
+	auto get_texture_size(const Texture &t) const -> mth::Dim<int>
 	{
 		mth::Dim<int> d;
 		ASSERT(SDL_QueryTexture(t.get(), nullptr, nullptr, &d.w, &d.h) == 0, SDL_GetError());
@@ -99,6 +165,14 @@ public:
 		return d;
 	}
 
+	auto get_output_size() const -> mth::Dim<int>
+	{
+		mth::Dim<int> d;
+		ASSERT(SDL_GetRendererOutputSize(c.r.get(), &d.w, &d.h) == 0, SDL_GetError());
+
+		return d;
+	}
+
 	void render_target()
 	{
 		SDL_RenderPresent(c.r.get());
@@ -115,14 +189,167 @@ public:
 	}
 
 	auto create_text(const Font &f, std::string_view text) const
+	{
+		return create_image_texture(raster_text(f, text));
+	}
+
+	/**
+	 * @brief Render text to cpu pixels (font must not be used by another thread meanwhile)
+	 */
+	static auto raster_text(const Font &f, std::string_view text) -> Image
 	{
 		if (text == "") // Avoid crash on empty string
 			text = " ";
 
-		sdl::Surface s(TTF_RenderText_Blended_Wrapped(f.get(), text.data(), sdl::BLACK, 600));
+		Image s(TTF_RenderText_Blended_Wrapped(f.get(), text.data(), sdl::BLACK, 600));
+		ASSERT(s != nullptr, TTF_GetError());
+
+		return s;
+	}
+
+	/**
+	 * @brief Render a single utf-8 character on a full line height to cpu pixels
+	 */
+	static auto raster_glyph(const Font &f, const std::string &ch) -> Image
+	{
+		Image s(TTF_RenderUTF8_Blended(f.get(), ch.c_str(), sdl::BLACK));
 		ASSERT(s != nullptr, TTF_GetError());
 
-		return Texture(SDL_CreateTextureFromSurface(c.r.get(), s.get()));
+		return s;
+	}
+
+	/**
+	 * @brief Render a single utf-8 character as a signed distance field to cpu pixels
+	 *
+	 * @param f Font to render with
+	 * @param ch Character to render
+	 * @param spread Padding and distance in pixels from the outline until alpha reaches 0 or 1
+	 *
+	 * @return Black pixels whose alpha is 0.5 on the outline
+	 */
+	static auto raster_sdf(const Font &f, const std::string &ch, int spread) -> Image
+	{
+		const auto g = raster_glyph(f, ch); // 32 bit argb
+		const auto w = g->w + spread * 2;
+		const auto h = g->h + spread * 2;
+
+		std::vector<uint8_t> in((size_t)w * h, 0);
+
+		for (int y = 0; y < g->h; ++y)
+			for (int x = 0; x < g->w; ++x)
+			{
+				const auto px = ((const uint32_t *)((const uint8_t *)g->pixels + (size_t)y * g->pitch))[x];
+				in[(size_t)(y + spread) * w + x + spread] = (px >> 24) >= 128;
+			}
+
+		Image s(SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888));
+		ASSERT(s != nullptr, SDL_GetError());
+
+		for (int y = 0; y < h; ++y)
+		{
+			auto *const row = (uint32_t *)((uint8_t *)s->pixels + (size_t)y * s->pitch);
+
+			for (int x = 0; x < w; ++x)
+			{
+				const auto inside = in[(size_t)y * w + x];
+				auto	   best	  = (float)(spread * spread);
+
+				// Nearest pixel on the other side of the outline within the spread
+				for (int dy = std::max(-spread, -y); dy <= std::min(spread, h - 1 - y); ++dy)
+					for (int dx = std::max(-spread, -x); dx <= std::min(spread, w - 1 - x); ++dx)
+						if (in[(size_t)(y + dy) * w + x + dx] != inside)
+							best = std::min(best, (float)(dx * dx + dy * dy));
+
+				const auto d = std::min(std::sqrt(best) - 0.5F, (float)spread) * (inside ? 1.F : -1.F);
+				const auto a = std::clamp(0.5F + d / (2.F * spread), 0.F, 1.F);
+
+				row[x] = (uint32_t)std::lround(a * 255.F) << 24;
+			}
+		}
+
+		return s;
+	}
+
+	/**
+	 * @brief Get the pen movement after a character, 0 when not in the font
+	 */
+	static auto glyph_advance(const Font &f, uint32_t ch) -> int
+	{
+		int adv = 0;
+
+		if (ch > 0xFFFF || TTF_GlyphMetrics(f.get(), (Uint16)ch, nullptr, nullptr, nullptr, nullptr, &adv) != 0)
+			return 0;
+
+		return adv;
+	}
+
+	/**
+	 * @brief Get the distance between two baselines
+	 */
+	static auto line_skip(const Font &f) -> int
+	{
+		return TTF_FontLineSkip(f.get());
+	}
+
+	/**
+	 * @brief Create transparent cpu pixels to raster onto
+	 */
+	static auto create_image(mth::Dim<int> size) -> Image
+	{
+		Image s(SDL_CreateRGBSurfaceWithFormat(0, size.w, size.h, 32, SDL_PIXELFORMAT_ARGB8888)); // Zeroed
+		ASSERT(s != nullptr, SDL_GetError());
+
+		return s;
+	}
+
+	/**
+	 * @brief Render a stroke to cpu pixels
+	 */
+	static auto raster_stroke(mth::Dim<int> size, SDL_Color col, float r, std::span<const mth::Point<int>> ps) -> Image
+	{
+		auto s = create_image(size);
+		raster_stroke(s, col, r, ps);
+
+		return s;
+	}
+
+	/**
+	 * @brief Render a stroke over existing cpu pixels
+	 */
+	static void raster_stroke(const Image &s, SDL_Color col, float r, std::span<const mth::Point<int>> ps)
+	{
+		const mth::Dim<int> size = { s->w, s->h };
+
+		CairoSurface cs(
+			cairo_image_surface_create_for_data((unsigned char *)s->pixels, CAIRO_FORMAT_ARGB32, size.w, size.h, s->pitch));
+		CairoContext cx(cairo_create(cs.get()));
+
+		cairo_set_source_rgba(cx.get(), col.r / 255., col.g / 255., col.b / 255., col.a / 255.);
+		cairo_set_line_width(cx.get(), r);
+		cairo_set_line_cap(cx.get(), CAIRO_LINE_CAP_ROUND);
+		cairo_set_line_join(cx.get(), CAIRO_LINE_JOIN_ROUND);
+
+		if (!ps.empty())
+		{
+			cairo_move_to(cx.get(), (double)ps[0].x, (double)ps[0].y);
+
+			if (ps.size() == 1) // Dots
+				cairo_line_to(cx.get(), (double)ps[0].x, (double)ps[0].y);
+
+			for (auto i = ps.begin() + 1; i < ps.end(); ++i) cairo_line_to(cx.get(), (double)i->x, (double)i->y);
+
+			cairo_stroke(cx.get());
+		}
+
+		cairo_surface_flush(cs.get());
+	}
+
+	auto create_image_texture(const Image &i) const -> Texture
+	{
+		Texture t(SDL_CreateTextureFromSurface(c.r.get(), i.get()));
+		ASSERT(t != nullptr, SDL_GetError());
+
+		return t;
 	}
 
 	auto load_bmp(const char *path) -> std::optional<Texture>
@@ -146,6 +373,179 @@ public:
 		ASSERT(SDL_RenderCopy(c.r.get(), t.get(), &sdl::to_rect(source), &sdl::to_rect(dest)) == 0, SDL_GetError());
 	}
 
+	/**
+	 * @brief Draw many frames of one texture in a single batch
+	 */
+	void draw_frames(const Texture &t, std::span<const mth::Rect<int>> sources,
+					 std::span<const mth::Rect<int>> dests) const
+	{
+		assert(sources.size() == dests.size());
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+		const auto s = get_texture_size(t);
+
+		std::vector<SDL_Vertex> vs;
+		std::vector<int>		is;
+		vs.reserve(sources.size() * 4);
+		is.reserve(sources.size() * 6);
+
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			const auto &src = sources[i];
+			const auto &dst = dests[i];
+
+			const auto u1 = (float)src.x / s.w, v1 = (float)src.y / s.h;
+			const auto u2 = (float)(src.x + src.w) / s.w, v2 = (float)(src.y + src.h) / s.h;
+
+			const auto x1 = (float)dst.x, y1 = (float)dst.y;
+			const auto x2 = (float)(dst.x + dst.w), y2 = (float)(dst.y + dst.h);
+
+			const auto b = (int)vs.size();
+
+			vs.push_back({ { x1, y1 }, sdl::WHITE, { u1, v1 } });
+			vs.push_back({ { x2, y1 }, sdl::WHITE, { u2, v1 } });
+			vs.push_back({ { x2, y2 }, sdl::WHITE, { u2, v2 } });
+			vs.push_back({ { x1, y2 }, sdl::WHITE, { u1, v2 } });
+
+			is.insert(is.end(), { b, b + 1, b + 2, b, b + 2, b + 3 });
+		}
+
+		ASSERT(SDL_RenderGeometry(c.r.get(), t.get(), vs.data(), (int)vs.size(), is.data(), (int)is.size()) == 0,
+			   SDL_GetError());
+#else
+		for (size_t i = 0; i < sources.size(); ++i) draw_frame(t, sources[i], dests[i]);
+#endif
+	}
+
+	/**
+	 * @brief Draw many frames of one texture keeping the larger color & alpha where they overlap
+	 *
+	 * Overlapping distance fields join like their shapes instead of adding up. Renderers without custom blend modes
+	 * blend as usual.
+	 */
+	void draw_frames_max(const Texture &t, std::span<const mth::Rect<int>> sources,
+						 std::span<const mth::Rect<int>> dests) const
+	{
+		const auto max = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE, SDL_BLENDOPERATION_MAXIMUM,
+													SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE,
+													SDL_BLENDOPERATION_MAXIMUM); // max(src, dst)
+
+		SDL_BlendMode mode;
+		SDL_GetTextureBlendMode(t.get(), &mode);
+
+		const auto set = SDL_SetTextureBlendMode(t.get(), max) == 0;
+		draw_frames(t, sources, dests);
+
+		if (set)
+			SDL_SetTextureBlendMode(t.get(), mode);
+	}
+
+	/**
+	 * @brief Draw untextured triangles in one batch (only if GEOMETRY)
+	 */
+	void draw_mesh([[maybe_unused]] std::span<const mth::Point<float>> vs, [[maybe_unused]] std::span<const SDL_Color> cols,
+				   [[maybe_unused]] std::span<const int> is) const // Unused without SDL_RenderGeometry
+	{
+		assert(vs.size() == cols.size());
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+		std::vector<SDL_Vertex> svs(vs.size());
+
+		for (size_t i = 0; i < vs.size(); ++i) svs[i] = { { vs[i].x, vs[i].y }, cols[i], { 0.F, 0.F } };
+
+		ASSERT(SDL_RenderGeometry(c.r.get(), nullptr, svs.data(), (int)svs.size(), is.data(), (int)is.size()) == 0,
+			   SDL_GetError());
+#else
+		assert(false && "SDL_RenderGeometry requires SDL 2.0.18.");
+#endif
+	}
+
+	// -----------------------------------------------------------------------------
+	// Atlas
+	// -----------------------------------------------------------------------------
+
+	/**
+	 * @brief Create a transparent texture other textures can be copied into
+	 */
+	auto create_atlas_page(int size) const -> Texture
+	{
+		Texture t(SDL_CreateTexture(c.r.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, size, size));
+		ASSERT(t != nullptr, SDL_GetError());
+
+		SDL_SetTextureBlendMode(t.get(), SDL_BLENDMODE_BLEND);
+
+		auto *const prev = SDL_GetRenderTarget(c.r.get());
+
+		SDL_SetRenderTarget(c.r.get(), t.get());
+		SDL_SetRenderDrawColor(c.r.get(), 0, 0, 0, 0);
+		SDL_RenderClear(c.r.get());
+		SDL_SetRenderTarget(c.r.get(), prev);
+
+		return t;
+	}
+
+	/**
+	 * @brief Redirect drawing into a transparent layer covering the draw area
+	 */
+	void begin_layer()
+	{
+		const auto s = get_output_size();
+
+		if (const auto l = c.layer ? get_texture_size(c.layer) : mth::Dim<int>{ 0, 0 }; l.w != s.w || l.h != s.h)
+		{
+			c.layer.reset(SDL_CreateTexture(c.r.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, s.w, s.h));
+			ASSERT(c.layer != nullptr, SDL_GetError());
+
+			SDL_SetTextureBlendMode(c.layer.get(), SDL_BLENDMODE_BLEND);
+		}
+
+		const auto a = get_draw_area();
+
+		SDL_SetRenderTarget(c.r.get(), c.layer.get());
+		SDL_SetRenderDrawBlendMode(c.r.get(), SDL_BLENDMODE_NONE);
+		SDL_SetRenderDrawColor(c.r.get(), 0, 0, 0, 0);
+		SDL_RenderFillRect(c.r.get(), &sdl::to_rect(a));
+	}
+
+	/**
+	 * @brief Sharpen the layer alpha around 0.5 and draw the layer onto the frame
+	 *
+	 * @param steps Times the alpha slope is doubled, 0 draws the layer as is
+	 */
+	void end_layer(int steps)
+	{
+		const auto a = get_draw_area();
+
+		if (steps > 0)
+			_sharpen_layer(a, steps);
+
+		SDL_SetRenderDrawBlendMode(c.r.get(), SDL_BLENDMODE_NONE);
+		SDL_SetRenderTarget(c.r.get(), c.back.get());
+
+		if (c.clip) // Reset by the target switch
+			SDL_RenderSetClipRect(c.r.get(), &sdl::to_rect(*c.clip));
+
+		ASSERT(SDL_RenderCopy(c.r.get(), c.layer.get(), &sdl::to_rect(a), &sdl::to_rect(a)) == 0, SDL_GetError());
+	}
+
+	/**
+	 * @brief Copy a part of a texture into another texture replacing its pixels
+	 */
+	void copy_frame(const Texture &src, mth::Rect<int> source, const Texture &dst, mth::Rect<int> dest) const
+	{
+		auto *const prev = SDL_GetRenderTarget(c.r.get());
+
+		SDL_BlendMode mode;
+		SDL_GetTextureBlendMode(src.get(), &mode);
+		SDL_SetTextureBlendMode(src.get(), SDL_BLENDMODE_NONE); // Keep alpha as is
+
+		SDL_SetRenderTarget(c.r.get(), dst.get());
+		SDL_RenderCopy(c.r.get(), src.get(), &sdl::to_rect(source), &sdl::to_rect(dest));
+		SDL_SetRenderTarget(c.r.get(), prev);
+
+		SDL_SetTextureBlendMode(src.get(), mode);
+	}
+
 	// -----------------------------------------------------------------------------
 	// Primitive rendering
 	// -----------------------------------------------------------------------------
@@ -184,32 +584,126 @@ public:
 		int	  pitch;
 		SDL_LockTexture(t.get(), nullptr, &pixels, &pitch);
 
-		std::memset(pixels, 0, pitch / 4 * h); // Make texture transparent (pitch is rgba * width)
+		std::memset(pixels, 0, pitch * h); // Make texture transparent (pitch is rgba * width)
 
 		// God, please let the address stay the same
 		c.surf.reset(cairo_image_surface_create_for_data((unsigned char *)pixels, CAIRO_FORMAT_ARGB32, w, h, pitch));
 		c.cxt.reset(cairo_create(c.surf.get()));
+		c.pen = c.cxt.get();
+
+		return t;
+	}
+
+	/**
+	 * @brief Create a cpu stroke buffer covering a screen area mirrored by a texture
+	 */
+	auto create_stroke_buffer(mth::Rect<int> area) -> StrokeBuffer
+	{
+		auto b = _make_stroke_buffer(area);
+		upload_stroke_buffer(b, area);
+
+		return b;
+	}
+
+	/**
+	 * @brief Enlarge a stroke buffer keeping its content
+	 */
+	void grow_stroke_buffer(StrokeBuffer &b, mth::Rect<int> area)
+	{
+		auto nb = _make_stroke_buffer(area);
+
+		cairo_save(nb.cxt.get());
+		cairo_set_source_surface(nb.cxt.get(), b.surf.get(), b.area.x, b.area.y);
+		cairo_set_operator(nb.cxt.get(), CAIRO_OPERATOR_SOURCE);
+		cairo_paint(nb.cxt.get());
+		cairo_restore(nb.cxt.get());
+
+		upload_stroke_buffer(nb, area);
+
+		if (c.pen == b.cxt.get())
+			c.pen = nb.cxt.get();
+
+		b = std::move(nb);
+	}
+
+	/**
+	 * @brief Draw the following strokes into a stroke buffer
+	 */
+	void set_stroke_buffer(const StrokeBuffer &b)
+	{
+		assert(b.cxt);
+		c.pen = b.cxt.get();
+	}
+
+	/**
+	 * @brief Upload a screen area of the stroke buffer to its texture
+	 */
+	void upload_stroke_buffer(const StrokeBuffer &b, mth::Rect<int> area) const
+	{
+		const auto x1 = std::max(area.x, b.area.x) - b.area.x;
+		const auto y1 = std::max(area.y, b.area.y) - b.area.y;
+		const auto x2 = std::min(area.x + area.w, b.area.x + b.area.w) - b.area.x;
+		const auto y2 = std::min(area.y + area.h, b.area.y + b.area.h) - b.area.y;
+
+		if (x2 <= x1 || y2 <= y1)
+			return;
+
+		cairo_surface_flush(b.surf.get());
+
+		const auto stride = cairo_image_surface_get_stride(b.surf.get());
+		const auto pixels = cairo_image_surface_get_data(b.surf.get()) + y1 * stride + x1 * 4;
+
+		const SDL_Rect r = { x1, y1, x2 - x1, y2 - y1 };
+		ASSERT(SDL_UpdateTexture(b.tex.get(), &r, pixels, stride) == 0, SDL_GetError());
+	}
+
+	/**
+	 * @brief Copy a screen area of the stroke buffer into a new texture
+	 */
+	auto crop_stroke_buffer(const StrokeBuffer &b, mth::Rect<int> area) const -> Texture
+	{
+		assert(area.w > 0 && area.h > 0 && "Empty stroke area.");
+
+		Texture t(SDL_CreateTexture(c.r.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, area.w, area.h));
+		ASSERT(t != nullptr, SDL_GetError());
+		SDL_SetTextureBlendMode(t.get(), SDL_BLENDMODE_BLEND);
+
+		cairo_surface_flush(b.surf.get());
+
+		const auto stride = cairo_image_surface_get_stride(b.surf.get());
+		const auto pixels = cairo_image_surface_get_data(b.surf.get()) + (area.y - b.area.y) * stride
+			+ (area.x - b.area.x) * 4;
+
+		ASSERT(SDL_UpdateTexture(t.get(), nullptr, pixels, stride) == 0, SDL_GetError());
 
 		return t;
 	}
 
 	void set_stroke_color(SDL_Color col)
 	{
-		assert(c.cxt);
-		cairo_set_source_rgba(c.cxt.get(), col.r / 255., col.g / 255., col.b / 255., col.a / 255.);
+		assert(c.pen);
+		cairo_set_source_rgba(c.pen, col.r / 255., col.g / 255., col.b / 255., col.a / 255.);
 	}
 
 	void set_stroke_target(const CacheTexture &t, mth::Rect<int> area, float r)
 	{
-		assert(t && c.cxt);
+		assert(t && c.pen);
 
 		void *pixels;
 		int	  pitch;
 
 		SDL_LockTexture(t.get(), &sdl::to_rect(area), &pixels, &pitch);
 
-		cairo_set_line_width(c.cxt.get(), r);
-		cairo_set_line_cap(c.cxt.get(), CAIRO_LINE_CAP_ROUND);
+		set_stroke_width(r);
+	}
+
+	void set_stroke_width(float r)
+	{
+		assert(c.pen);
+
+		cairo_set_line_width(c.pen, r);
+		cairo_set_line_cap(c.pen, CAIRO_LINE_CAP_ROUND);
+		cairo_set_line_join(c.pen, CAIRO_LINE_JOIN_ROUND);
 	}
 
 	void render_stroke(const CacheTexture &t)
@@ -220,17 +714,17 @@ public:
 
 	void draw_stroke(mth::Point<int> from, mth::Point<int> to) const
 	{
-		assert(c.cxt);
+		assert(c.pen);
 
-		cairo_move_to(c.cxt.get(), (double)from.x, (double)from.y);
-		cairo_line_to(c.cxt.get(), (double)to.x, (double)to.y);
+		cairo_move_to(c.pen, (double)from.x, (double)from.y);
+		cairo_line_to(c.pen, (double)to.x, (double)to.y);
 
-		cairo_stroke(c.cxt.get());
+		cairo_stroke(c.pen);
 	}
 
 	void draw_stroke_multi(std::span<mth::Point<int>> arr) const
 	{
-		assert(c.cxt);
+		assert(c.pen);
 
 		if (arr.size() <= 1)
 			return;
@@ -241,13 +735,146 @@ public:
 			return;
 		}
 
-		cairo_move_to(c.cxt.get(), (double)arr[0].x, (double)arr[0].y);
+		cairo_move_to(c.pen, (double)arr[0].x, (double)arr[0].y);
 
-		for (auto i = arr.begin() + 1; i != arr.end(); ++i) cairo_line_to(c.cxt.get(), (double)i->x, (double)i->y);
+		for (auto i = arr.begin() + 1; i != arr.end(); ++i) cairo_line_to(c.pen, (double)i->x, (double)i->y);
 
-		cairo_stroke(c.cxt.get());
+		cairo_stroke(c.pen);
 	}
 
 private:
 	RendererContext c;
+
+	/**
+	 * @brief (Re)create the back buffer if it doesn't match the window
+	 */
+	void _fit_back_buffer()
+	{
+		const auto s = get_output_size();
+
+		if (const auto b = c.back ? get_texture_size(c.back) : mth::Dim<int>{ 0, 0 }; b.w == s.w && b.h == s.h)
+			return;
+
+		c.back.reset(SDL_CreateTexture(c.r.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, s.w, s.h));
+		ASSERT(c.back != nullptr, SDL_GetError());
+
+		c.refresh = true;
+	}
+
+	/**
+	 * @brief Map the layer alpha a to clamp(k * (a - 0.5) + 0.5) with k = 2^steps using blending only
+	 *
+	 * Renderers without custom blend modes keep the soft alpha.
+	 */
+	void _sharpen_layer(mth::Rect<int> a, int steps)
+	{
+		const auto k = (float)(1 << steps);
+
+		const auto sub = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ZERO, SDL_BLENDFACTOR_ONE, SDL_BLENDOPERATION_ADD,
+													SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE,
+													SDL_BLENDOPERATION_REV_SUBTRACT); // dst - src
+		const auto dbl = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ZERO, SDL_BLENDFACTOR_ONE, SDL_BLENDOPERATION_ADD,
+													SDL_BLENDFACTOR_DST_ALPHA, SDL_BLENDFACTOR_ONE,
+													SDL_BLENDOPERATION_ADD); // dst + dst
+
+		if (SDL_SetRenderDrawBlendMode(c.r.get(), sub) != 0)
+			return;
+
+		SDL_SetRenderDrawColor(c.r.get(), 0, 0, 0, (Uint8)std::lround((0.5F - 0.5F / k) * 255.F));
+		SDL_RenderFillRect(c.r.get(), &sdl::to_rect(a));
+
+		if (SDL_SetRenderDrawBlendMode(c.r.get(), dbl) != 0)
+			return;
+
+		SDL_SetRenderDrawColor(c.r.get(), 0, 0, 0, 255);
+		for (int i = 0; i < steps; ++i) SDL_RenderFillRect(c.r.get(), &sdl::to_rect(a));
+	}
+
+	/**
+	 * @brief Allocate a transparent stroke buffer without uploading it
+	 */
+	auto _make_stroke_buffer(mth::Rect<int> area) -> StrokeBuffer
+	{
+		StrokeBuffer b;
+
+		b.area = area;
+		b.surf.reset(cairo_image_surface_create(CAIRO_FORMAT_ARGB32, area.w, area.h)); // Starts transparent
+		b.cxt.reset(cairo_create(b.surf.get()));
+		cairo_translate(b.cxt.get(), -area.x, -area.y); // Draw using screen coordinates
+
+		b.tex.reset(SDL_CreateTexture(c.r.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, area.w, area.h));
+		ASSERT(b.tex != nullptr, SDL_GetError());
+		SDL_SetTextureBlendMode(b.tex.get(), SDL_BLENDMODE_BLEND);
+
+		return b;
+	}
+
+	/**
+	 * @brief Merge the damaged areas into a few clip areas
+	 *
+	 * Overlapping areas are merged, and once DAMAGE_RECTS are kept each further one joins the area it grows least.
+	 * If they cover much of the screen, their union is redrawn in one pass instead.
+	 */
+	auto _damage_areas() const -> std::vector<mth::Rect<int>>
+	{
+		const auto unite = [](mth::Rect<int> a, mth::Rect<int> b) -> mth::Rect<int>
+		{
+			const auto x1 = std::min(a.x, b.x), y1 = std::min(a.y, b.y);
+			return { x1, y1, std::max(a.x + a.w, b.x + b.w) - x1, std::max(a.y + a.h, b.y + b.h) - y1 };
+		};
+
+		const auto size	   = [](mth::Rect<int> a) { return (int64_t)a.w * a.h; };
+		const auto overlap = [](mth::Rect<int> a, mth::Rect<int> b)
+		{ return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h; };
+
+		const auto s = get_output_size();
+
+		std::vector<mth::Rect<int>> areas;
+		mth::Rect<int>				all = c.damage.front();
+
+		for (const auto &d : c.damage)
+		{
+			all = unite(all, d);
+
+			if (!overlap(d, { 0, 0, s.w, s.h })) // Off screen
+				continue;
+
+			size_t	best = areas.size();
+			int64_t grow = std::numeric_limits<int64_t>::max();
+
+			for (size_t i = 0; i < areas.size(); ++i)
+				if (overlap(areas[i], d) || areas.size() == DAMAGE_RECTS)
+					if (const auto g = size(unite(areas[i], d)) - size(areas[i]); g < grow)
+					{
+						best = i;
+						grow = g;
+					}
+
+			if (best == areas.size())
+			{
+				areas.push_back(d);
+				continue;
+			}
+
+			areas[best] = unite(areas[best], d);
+
+			for (size_t i = 0; i < areas.size(); ++i) // The grown area might reach others now
+				if (i != best && overlap(areas[i], areas[best]))
+				{
+					areas[best] = unite(areas[best], areas[i]);
+					areas.erase(areas.begin() + i);
+
+					best -= best > i;
+					i = (size_t)-1; // Check all again
+				}
+		}
+
+		int64_t covered = 0;
+		for (const auto &a : areas) covered += size(a);
+
+		if (covered > (int64_t)((float)s.w * s.h * DAMAGE_UNION))
+			return { all };
+
+		return areas;
+	}
 };
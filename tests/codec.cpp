@@ -0,0 +1,185 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+#include "canvas/codec.h"
+
+struct Move
+{
+	int16_t dx, dy;
+};
+
+/**
+ * @brief Report a failed check
+ */
+static auto check(bool ok, const char *name) -> bool
+{
+	if (!ok)
+		std::printf("Failed: %s\n", name);
+
+	return ok;
+}
+
+/**
+ * @brief Check that a call rejects its input
+ */
+template<typename F>
+static auto throws(F &&f) -> bool
+{
+	try
+	{
+		f();
+	}
+	catch (const std::runtime_error &)
+	{
+		return true;
+	}
+
+	return false;
+}
+
+static auto test_zigzag() -> bool
+{
+	auto ok = true;
+
+	for (int v = INT16_MIN; v <= INT16_MAX; ++v) ok &= unzigzag(zigzag((int16_t)v)) == v;
+
+	ok &= check(zigzag(0) == 0 && zigzag(-1) == 1 && zigzag(1) == 2, "Small moves stay small");
+	ok &= check(zigzag(INT16_MAX) == 0xFFFE && zigzag(INT16_MIN) == 0xFFFF, "Extreme moves");
+
+	return check(ok, "Zigzag round trip");
+}
+
+static auto test_varint() -> bool
+{
+	auto ok = true;
+
+	for (const auto &[v, n] : { std::pair{ 0U, 1U }, { 0x7FU, 1U }, { 0x80U, 2U }, { 0x3FFFU, 2U }, { 0x4000U, 3U },
+							   { 0xFFFFU, 3U } })
+	{
+		std::string s;
+		put_varint(s, v);
+
+		size_t pos = 0;
+		ok &= check(s.size() == n && get_varint(s, pos) == v && pos == n, "Varint length & value");
+	}
+
+	ok &= check(throws(
+					[]
+					{
+						size_t pos = 0;
+						get_varint(std::string_view("\x80\x80"), pos);
+					}),
+				"Cut off varint");
+
+	ok &= check(throws(
+					[]
+					{
+						size_t pos = 0;
+						get_varint(std::string_view("\x80\x80\x80\x01"), pos);
+					}),
+				"Varint longer than 3 bytes");
+
+	return ok;
+}
+
+static auto test_points() -> bool
+{
+	const std::vector<Move> ms = {
+		{ 0, 0 }, { 1, -1 }, { 63, -64 }, { 64, -65 }, { INT16_MAX, INT16_MIN }, { INT16_MIN, INT16_MAX }, { -3, 5 },
+	};
+
+	std::string d;
+	pack_points(std::span<const Move>(ms), d);
+	d += '\x7F'; // Next stroke
+
+	std::vector<Move> out(ms.size());
+	size_t			  pos = 0;
+	unpack_points<Move>(d, pos, out);
+
+	auto ok = check(pos == d.size() - 1, "Unpack stops at the end of the stroke");
+
+	for (size_t i = 0; i < ms.size(); ++i) ok &= check(out[i].dx == ms[i].dx && out[i].dy == ms[i].dy, "Move kept");
+
+	size_t skip = 0;
+	skip_points(d, skip, (uint32_t)ms.size());
+	ok &= check(skip == pos, "Skip finds the same end");
+
+	const auto cut = std::string_view(d).substr(0, d.size() - 3);
+
+	ok &= check(throws(
+					[&]
+					{
+						size_t p = 0;
+						skip_points(cut, p, (uint32_t)ms.size());
+					}),
+				"Skip rejects a cut off stroke");
+
+	ok &= check(throws(
+					[&]
+					{
+						std::vector<Move> o(ms.size());
+						size_t			  p = 0;
+						unpack_points<Move>(cut, p, o);
+					}),
+				"Unpack rejects a cut off stroke");
+
+	ok &= check(throws(
+					[]
+					{
+						size_t p = 0;
+						skip_points(std::string_view("\x80\x80\x04\x00", 4), p, 1); // 0x10000
+					}),
+				"Skip rejects moves outside of 16 bits");
+
+	return ok;
+}
+
+static auto test_base64() -> bool
+{
+	// RFC 4648 vectors, padded by 2, 1 & 0 bytes
+	const std::pair<std::string_view, std::string_view> vs[] = {
+		{ "", "" },
+		{ "f", "Zg==" },
+		{ "fo", "Zm8=" },
+		{ "foo", "Zm9v" },
+		{ "foob", "Zm9vYg==" },
+		{ "fooba", "Zm9vYmE=" },
+		{ "foobar", "Zm9vYmFy" },
+		{ std::string_view("\xFF\x00\x80", 3), "/wCA" }, // High bits & a zero byte
+	};
+
+	auto ok = true;
+
+	for (const auto &[plain, enc] : vs)
+	{
+		std::string e, d, u;
+		base64_encode(plain, e);
+		base64_decode(e, d);
+
+		base64_decode(std::string(enc.substr(0, enc.find('='))), u); // Padding is optional
+
+		ok &= check(e == enc && d == plain && u == plain, "Base64 round trip");
+	}
+
+	ok &= check(throws(
+					[]
+					{
+						std::string d;
+						base64_decode("Zm9v!", d);
+					}),
+				"Base64 rejects other characters");
+
+	return ok;
+}
+
+auto main() -> int
+{
+	auto ok = test_zigzag();
+	ok &= test_varint();
+	ok &= test_points();
+	ok &= test_base64();
+
+	return ok ? 0 : 1;
+}
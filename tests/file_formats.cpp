@@ -0,0 +1,298 @@
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+#include "canvas/save.h"
+
+static const auto DIR = std::filesystem::temp_directory_path();
+
+// Largest moves both ways, small ones & a 3 byte varint per axis
+static const std::vector<LinePoint> MOVES = {
+	{ 0, 0 }, { INT16_MAX, INT16_MIN }, { INT16_MIN, INT16_MAX }, { 1, -1 }, { -64, 64 }, { 8191, -8192 }, { 0, 0 },
+};
+
+/**
+ * @brief Report a failed check
+ */
+static auto check(bool ok, const char *name) -> bool
+{
+	if (!ok)
+		std::printf("Failed: %s\n", name);
+
+	return ok;
+}
+
+/**
+ * @brief Check that a call rejects its input
+ */
+template<typename F>
+static auto throws(F &&f) -> bool
+{
+	try
+	{
+		f();
+	}
+	catch (const std::runtime_error &)
+	{
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Write raw contents to a file in the temporary directory
+ */
+static auto write_file(const char *name, std::string_view d) -> std::string
+{
+	const auto file = (DIR / name).string();
+
+	std::ofstream f(file, std::ios::binary);
+	f.write(d.data(), (std::streamsize)d.size());
+
+	return file;
+}
+
+/**
+ * @brief Fill a canvas with a stroke of extreme moves, a plain one & a text
+ */
+static void generate(CanvasContext &c)
+{
+	c.swls.lines.push_back({ .offset = 0, .count = (uint32_t)MOVES.size(), .step = 0.5F });
+	c.swls.pts = MOVES;
+	c.swts.push_back({ .dim = { 1.F, 2.F, 3.F, 4.F } });
+	c.swlis.push_back({ 2.F, 1.F, { 1, 2, 3, 255 } });
+
+	const std::vector<mth::Point<float>> ps = { { 0.F, 0.F }, { 10.F, -5.F }, { 12.5F, 3.25F } };
+	c.swts.push_back({ .dim = { -7.F, 9.F, 20.F, 10.F } });
+	c.swls.push_back(ps, point_step(1.F));
+	c.swlis.push_back({ 3.F, 1.F, { 255, 0, 0, 255 } });
+
+	c.txwts.push_back({ .dim = { 5.F, 6.F, 0.F, 0.F } });
+	c.txwtxis.push_back({ .text = text_buffer("a & <b> \"c\"\né"), .scale = 2.F });
+}
+
+/**
+ * @brief Check that a loaded canvas holds the same strokes and texts
+ */
+static auto same(CanvasContext &a, CanvasContext &b) -> bool
+{
+	if (a.swts.size() != b.swts.size() || a.txwts.size() != b.txwts.size())
+		return false;
+
+	for (size_t i = 0; i < a.swts.size(); ++i)
+	{
+		const auto pa = a.swls.points(i);
+		const auto pb = b.swls.points(i);
+
+		const auto &da = a.swts[i].dim;
+		const auto &db = b.swts[i].dim;
+
+		if (pa.count != pb.count || pa.step != pb.step || std::memcmp(pa.data, pb.data, pa.count * sizeof(LinePoint)))
+			return false;
+
+		if (da.x != db.x || da.y != db.y || da.w != db.w || da.h != db.h)
+			return false;
+
+		if (std::memcmp(&a.swlis[i].color, &b.swlis[i].color, sizeof(SDL_Color)) ||
+			a.swlis[i].radius != b.swlis[i].radius || a.swlis[i].scale != b.swlis[i].scale)
+			return false;
+	}
+
+	for (size_t i = 0; i < a.txwts.size(); ++i)
+		if (text_string(a.txwtxis[i].text) != text_string(b.txwtxis[i].text) || a.txwts[i].dim.x != b.txwts[i].dim.x ||
+			a.txwts[i].dim.y != b.txwts[i].dim.y || a.txwtxis[i].scale != b.txwtxis[i].scale)
+			return false;
+
+	return true;
+}
+
+/**
+ * @brief Save, load back & compare a canvas
+ */
+static auto round_trip(const char *name) -> bool
+{
+	CanvasContext c, l;
+	generate(c);
+
+	const auto file = (DIR / name).string();
+	save(c, file.c_str());
+	load(l, file.c_str());
+
+	const auto ok = same(c, l);
+	std::filesystem::remove(file);
+
+	return check(ok, name);
+}
+
+/**
+ * @brief Load a version 1 file whose raw points are mapped
+ */
+static auto test_v1() -> bool
+{
+	CanvasContext c;
+	generate(c);
+
+	std::string out;
+
+	const FileHeader h = { .magic = FILE_MAGIC, .version = 1 };
+	out.append((const char *)&h, sizeof h);
+
+	std::vector<StrokeRecord> strokes;
+
+	for (size_t i = 0; i < c.swts.size(); ++i)
+	{
+		const auto &t  = c.swts[i];
+		const auto &l  = c.swls.lines[i];
+		const auto &li = c.swlis[i];
+
+		uint32_t color;
+		std::memcpy(&color, &li.color, sizeof color);
+
+		strokes.push_back({ .x		= t.dim.x,
+							.y		= t.dim.y,
+							.w		= t.dim.w,
+							.h		= t.dim.h,
+							.radius = li.radius,
+							.scale	= li.scale,
+							.step	= l.step,
+							.color	= color,
+							.offset = l.offset,
+							.count	= l.count });
+	}
+
+	const auto		   s	= text_string(c.txwtxis[0].text);
+	const TextRecord   text = { .x = 5.F, .y = 6.F, .scale = 2.F, .offset = 0, .size = (uint32_t)s.size() };
+	const CameraRecord cam	= { .x = 1.F, .y = 2.F, .scale = 4.F };
+
+	write_chunk(out, ChunkType::CAMERA, &cam, sizeof cam);
+	write_chunk(out, ChunkType::STROKES, strokes.data(), strokes.size() * sizeof(StrokeRecord));
+	write_chunk(out, ChunkType::POINTS, c.swls.pts.data(), c.swls.pts.size() * sizeof(LinePoint));
+	write_chunk(out, ChunkType::TEXTS, &text, sizeof text);
+	write_chunk(out, ChunkType::TEXT_DATA, s.data(), s.size());
+
+	const auto file = write_file("notetaker_v1.bin", out);
+
+	auto ok = false;
+
+	{
+		CanvasContext l; // Unmaps the file before it is removed
+		load(l, file.c_str());
+
+		ok = same(c, l) && l.cam.scale == 4.F && l.swls.lines[0].mapped;
+	}
+
+	std::filesystem::remove(file);
+
+	return check(ok, "Version 1 file");
+}
+
+/**
+ * @brief Load an XML file with a tag per point
+ */
+static auto test_legacy_xml() -> bool
+{
+	const auto file = write_file("notetaker_legacy.xml", R"(<?xml version="1.0"?>
+<doc>
+	<line>
+		<l r="3" c="4278190335" s="1" x="1" y="2" w="10" h="8">
+			<p x="0" y="0" />
+			<p x="4.5" y="-2.25" />
+			<p x="9" y="7" />
+		</l>
+	</line>
+	<text>
+		<t s="1" t="note" x="3" y="4" />
+	</text>
+</doc>
+)");
+
+	CanvasContext l;
+	load(l, file.c_str());
+	std::filesystem::remove(file);
+
+	if (!check(l.swts.size() == 1 && l.txwts.size() == 1, "Legacy xml items"))
+		return false;
+
+	const mth::Point<float> ps[] = { { 0.F, 0.F }, { 4.5F, -2.25F }, { 9.F, 7.F } };
+	const auto				lp	 = l.swls.points(0);
+
+	auto   ok = lp.count == 3 && l.swts[0].dim.w == 10.F && text_string(l.txwtxis[0].text) == "note";
+	size_t i  = 0;
+
+	for (const auto p : lp)
+	{
+		ok &= std::abs(p.x - ps[i].x) <= lp.step && std::abs(p.y - ps[i].y) <= lp.step;
+		++i;
+	}
+
+	return check(ok, "Legacy xml points");
+}
+
+/**
+ * @brief Reject packed points that are cut off or corrupt, in both formats
+ */
+static auto test_corrupt() -> bool
+{
+	std::string out;
+
+	const FileHeader h = { .magic = FILE_MAGIC, .version = FILE_VERSION };
+	out.append((const char *)&h, sizeof h);
+
+	const StrokeRecord s	  = { .step = 1.F, .offset = 0, .count = 2 };
+	const auto		   packed = std::string_view("\x02\x02\x80\x80", 4); // Second move cut off
+
+	write_chunk(out, ChunkType::STROKES, &s, sizeof s);
+	write_chunk(out, ChunkType::PACKED_POINTS, packed.data(), packed.size());
+
+	const auto bin = write_file("notetaker_corrupt.bin", out);
+
+	auto ok = check(throws(
+						[&]
+						{
+							CanvasContext l;
+							load(l, bin.c_str());
+						}),
+					"Cut off packed chunk");
+
+	std::filesystem::remove(bin);
+
+	// "AgI=" holds a single point while the tag claims 2, then a character outside of base64
+	for (const auto *p : { "AgI=", "Ag!I" })
+	{
+		const auto xml = write_file("notetaker_corrupt.xml", std::string(R"(<?xml version="1.0"?>
+<doc>
+	<line>
+		<l r="3" c="0" s="1" x="0" y="0" w="1" h="1" q="1" n="2" p=")") + p + R"(" />
+	</line>
+</doc>
+)");
+
+		ok &= check(throws(
+						[&]
+						{
+							CanvasContext l;
+							load(l, xml.c_str());
+						}),
+					"Broken xml points");
+
+		std::filesystem::remove(xml);
+	}
+
+	return ok;
+}
+
+auto main() -> int
+{
+	auto ok = round_trip("notetaker_formats.bin");
+	ok &= round_trip("notetaker_formats.xml");
+	ok &= test_v1();
+	ok &= test_legacy_xml();
+	ok &= test_corrupt();
+
+	return ok ? 0 : 1;
+}
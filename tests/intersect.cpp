@@ -0,0 +1,152 @@
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include <random>
+
+#include "canvas/intersect.h"
+
+/**
+ * @brief Report a failed check
+ */
+static auto check(bool ok, const char *name) -> bool
+{
+	if (!ok)
+		std::printf("Failed: %s\n", name);
+
+	return ok;
+}
+
+/**
+ * @brief Check the segments one at a time
+ */
+static auto scalar_crosses(const float *xs, const float *ys, size_t n, mth::Point<float> p, mth::Point<float> q)
+	-> bool
+{
+	for (size_t i = 0; i + 1 < n; ++i)
+		if (segment_crosses(xs, ys, i, p, q))
+			return true;
+
+	return false;
+}
+
+/**
+ * @brief Compare the simd & scalar checks on every length around the lane boundaries
+ *
+ * Points on a small integer grid give exact products, so touching ends & collinear segments happen often.
+ */
+static auto test_equivalence() -> bool
+{
+	std::mt19937						g(1);
+	std::uniform_int_distribution<int> c(0, 4);
+
+	std::vector<float> xs, ys;
+	size_t			   crossed = 0, total = 0;
+
+	auto ok = true;
+
+	for (size_t n = 0; n <= 19; ++n)
+		for (int k = 0; k < 2000; ++k)
+		{
+			xs.resize(n);
+			ys.resize(n);
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				xs[i] = (float)c(g);
+				ys[i] = (float)c(g);
+			}
+
+			const mth::Point<float> p = { (float)c(g), (float)c(g) };
+			const mth::Point<float> q = { (float)c(g), (float)c(g) };
+
+			const auto s = polyline_crosses(xs.data(), ys.data(), n, p, q);
+
+			ok &= s == scalar_crosses(xs.data(), ys.data(), n, p, q);
+			crossed += s;
+			++total;
+		}
+
+	ok &= check(crossed > total / 4 && crossed < total, "Both outcomes are tested");
+
+	return check(ok, "Simd matches scalar");
+}
+
+/**
+ * @brief Collinear segments never cross, wherever they are in the lanes
+ */
+static auto test_collinear() -> bool
+{
+	auto ok = true;
+
+	for (size_t n = 2; n <= 12; ++n)
+	{
+		std::vector<float> xs(n), ys(n, 1.F);
+
+		for (size_t i = 0; i < n; ++i) xs[i] = (float)i;
+
+		ok &= !polyline_crosses(xs.data(), ys.data(), n, { -1.F, 1.F }, { 20.F, 1.F });
+
+		// A crossing in the last segment only, after the lanes
+		ys[n - 1] = 3.F;
+		ok &= polyline_crosses(xs.data(), ys.data(), n, { (float)n - 1.5F, 0.F }, { (float)n - 1.5F, 5.F });
+	}
+
+	return check(ok, "Collinear segments");
+}
+
+/**
+ * @brief Check that chunks decode to the same points as the whole stroke and bound them
+ */
+static auto test_chunks() -> bool
+{
+	std::mt19937					g(2);
+	std::normal_distribution<float> move(0.F, 3.F);
+
+	auto ok = true;
+
+	for (const auto n : { 1, 2, 64, 65, 66, 129, 130, 300 })
+	{
+		std::vector<mth::Point<float>> ps;
+		for (float x = 0.F, y = 0.F; ps.size() < (size_t)n; x += move(g), y += move(g)) ps.push_back({ x, y });
+
+		WorldLineDB db;
+		db.push_back(ps, point_step(1.F));
+
+		const auto lp = db.points(0);
+		const auto lb = build_bounds(lp, 0);
+
+		std::vector<float> xs, ys, cxs, cys;
+		decode_points(lp, xs, ys);
+
+		size_t segments = 0;
+
+		for (const auto &c : lb.chunks)
+		{
+			decode_points(chunk_points(lp, c), cxs, cys);
+
+			ok &= c.first == segments;
+			segments += cxs.size() - 1;
+
+			for (size_t i = 0; i < cxs.size(); ++i)
+			{
+				const auto a = c.area;
+
+				ok &= cxs[i] == xs[c.first + i] && cys[i] == ys[c.first + i];
+				ok &= cxs[i] >= a.x && cxs[i] <= a.x + a.w && cys[i] >= a.y && cys[i] <= a.y + a.h;
+			}
+		}
+
+		ok &= check(segments == (size_t)n - 1 || (n == 1 && lb.chunks.empty()), "Chunks cover every segment");
+	}
+
+	return check(ok, "Chunk offsets");
+}
+
+auto main() -> int
+{
+	auto ok = test_equivalence();
+	ok &= test_collinear();
+	ok &= test_chunks();
+
+	return ok ? 0 : 1;
+}
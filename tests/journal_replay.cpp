@@ -0,0 +1,187 @@
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+
+#include "canvas/journal.h"
+
+static const auto DIR = std::filesystem::temp_directory_path();
+
+/**
+ * @brief Report a failed check
+ */
+static auto check(bool ok, const char *name) -> bool
+{
+	if (!ok)
+		std::printf("Failed: %s\n", name);
+
+	return ok;
+}
+
+/**
+ * @brief Check that a call rejects its input
+ */
+template<typename F>
+static auto throws(F &&f) -> bool
+{
+	try
+	{
+		f();
+	}
+	catch (const std::runtime_error &)
+	{
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Read a whole file
+ */
+static auto read_file(const std::string &file) -> std::string
+{
+	std::ifstream f(file, std::ios::binary);
+	return { std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>() };
+}
+
+/**
+ * @brief Append a short stroke
+ */
+static void add_stroke(SaveState &c, float x)
+{
+	const std::vector<mth::Point<float>> ps = { { 0.F, 0.F }, { x, 2.F }, { 2.F * x, -1.F } };
+
+	c.swts.push_back({ .dim = { x, -x, 2.F * x, 3.F } });
+	c.swls.push_back(ps, point_step(1.F));
+	c.swlis.push_back({ 2.F, 1.F, { (uint8_t)x, 0, 0, 255 } });
+}
+
+/**
+ * @brief Append a text
+ */
+static void add_text(SaveState &c, std::string_view s, float x)
+{
+	c.txwts.push_back({ .dim = { x, x, 0.F, 0.F } });
+	c.txwtxis.push_back({ .text = text_buffer(s), .scale = 1.F });
+}
+
+/**
+ * @brief Check that two canvases hold the same strokes, texts & last change
+ */
+static auto same(SaveState &a, SaveState &b) -> bool
+{
+	if (a.swts.size() != b.swts.size() || a.txwts.size() != b.txwts.size() || a.seq != b.seq)
+		return false;
+
+	for (size_t i = 0; i < a.swts.size(); ++i)
+	{
+		const auto pa = a.swls.points(i);
+		const auto pb = b.swls.points(i);
+
+		const auto &da = a.swts[i].dim;
+		const auto &db = b.swts[i].dim;
+
+		if (pa.count != pb.count || pa.step != pb.step || std::memcmp(pa.data, pb.data, pa.count * sizeof(LinePoint)))
+			return false;
+
+		if (da.x != db.x || da.y != db.y || da.w != db.w || da.h != db.h || a.swlis[i].color.r != b.swlis[i].color.r)
+			return false;
+	}
+
+	for (size_t i = 0; i < a.txwts.size(); ++i)
+		if (text_string(a.txwtxis[i].text) != text_string(b.txwtxis[i].text) || a.txwts[i].dim.x != b.txwts[i].dim.x)
+			return false;
+
+	return true;
+}
+
+/**
+ * @brief Load the base file & replay a journal onto it
+ */
+static auto replayed(const std::string &base, std::string_view journal, SaveState &expected) -> bool
+{
+	CanvasContext l;
+	load(l, base.c_str());
+
+	return replay_journal(l, std::span(journal.data(), journal.size())) && same(expected, l);
+}
+
+auto main() -> int
+{
+	const auto base = (DIR / "notetaker_journal.bin").string();
+	const auto path = journal_path(base);
+
+	CanvasContext c;
+	c.id = 42;
+
+	for (int i = 1; i <= 3; ++i) add_stroke(c, (float)i);
+
+	add_text(c, "hello world", 1.F);
+	add_text(c, "second", 2.F);
+
+	save(c, base.c_str());
+	write_journal(c, path, {});
+
+	// Each change is journaled like the handlers do, then applied
+	add_stroke(c, 4.F);
+	journal_add_stroke(c);
+
+	c.select		= Select{ .idx = 0, .wt = &c.swts[0], .type = CanvasType::STROKE };
+	c.swts[0].dim.x = 50.F;
+	journal_move(c);
+
+	add_text(c, "new", 3.F);
+	journal_add_text(c);
+
+	auto &b = c.txwtxis[0].text;
+	text_move(b, 5);
+	journal_edit_text(c, 0, 9, "p!"); // More than before the cursor, clamped like the edit
+	text_erase(b, 5);
+	text_insert(b, "p!");
+
+	journal_erase_stroke(c, 1);
+	erase(1, c.swts, c.swls, c.swlis);
+
+	auto before = save_snapshot(c); // Without the last change
+
+	journal_erase_text(c, 1);
+	erase(1, c.txwts, c.txwtxis);
+
+	auto after = save_snapshot(c);
+	close_journal(c);
+
+	const auto d = read_file(path);
+
+	auto ok = check(text_string(after.txwtxis[0].text) == "p! world", "Edit applied");
+	ok &= check(replayed(base, d, after), "Replay all changes");
+
+	// A crash while appending leaves part of a record
+	ok &= check(replayed(base, std::string_view(d).substr(0, d.size() - 2), before), "Cut off last record");
+
+	const OpHeader partial = { .op = JournalOp::ADD_TEXT, .size = 100, .seq = after.seq + 1 };
+	ok &= check(replayed(base, d + std::string(record_bytes(partial)) + "abc", after), "Cut off trailing record");
+
+	// Edits outside of the text must not be clamped into it
+	for (const auto &e : { EditRecord{ .idx = 0, .pos = 12, .erase = 0, .size = 0 },
+						   EditRecord{ .idx = 0, .pos = 2, .erase = 3, .size = 0 },
+						   EditRecord{ .idx = 0, .pos = 0, .erase = 0, .size = 4 } })
+	{
+		const JournalHeader jh = { .magic = JOURNAL_MAGIC, .version = FILE_VERSION, .id = 42 };
+		const OpHeader		h  = { .op = JournalOp::EDIT_TEXT, .size = sizeof e, .seq = 1 };
+
+		auto bad = std::string(record_bytes(jh));
+		bad += record_bytes(h);
+		bad += record_bytes(e);
+
+		ok &= check(throws([&] { replayed(base, bad, after); }), "Edit outside of the text");
+	}
+
+	std::filesystem::remove(base);
+	std::filesystem::remove(path);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <filesystem>
+
+#include "canvas/save.h"
+
+static constexpr auto STROKES = 20000;
+static constexpr auto POINTS  = 200; // Per stroke
+static constexpr auto TEXTS	  = 500;
+
+/**
+ * @brief Fill a canvas with random walk strokes and some texts, like a long handwritten notebook
+ */
+static void generate(CanvasContext &c)
+{
+	std::mt19937						  g(1);
+	std::normal_distribution<float>		  move(0.F, 1.5F);
+	std::uniform_real_distribution<float> pos(-10000.F, 10000.F);
+
+	std::vector<mth::Point<float>> ps;
+
+	for (int s = 0; s < STROKES; ++s)
+	{
+		ps.clear();
+
+		for (float x = 0.F, y = 0.F; ps.size() < POINTS;)
+		{
+			x += move(g) + 1.F;
+			y += move(g);
+			ps.push_back({ x, y });
+		}
+
+		c.swts.push_back({ .dim = { pos(g), pos(g), 300.F, 40.F } });
+		c.swls.push_back(ps, point_step(1.F));
+		c.swlis.push_back({ 3.F, 1.F, { (uint8_t)s, 0, 0, 255 } });
+	}
+
+	for (int t = 0; t < TEXTS; ++t)
+	{
+		c.txwts.push_back({ .dim = { pos(g), pos(g), 0.F, 0.F } });
+		c.txwtxis.push_back({ .text = text_buffer("Note " + std::to_string(t) + " & <more> \"text\""), .scale = 1.F });
+	}
+}
+
+/**
+ * @brief Check that a loaded canvas holds the same strokes and texts
+ */
+static auto same(CanvasContext &a, CanvasContext &b) -> bool
+{
+	if (a.swts.size() != b.swts.size() || a.txwts.size() != b.txwts.size())
+		return false;
+
+	for (size_t i = 0; i < a.swts.size(); ++i)
+	{
+		const auto pa = a.swls.points(i);
+		const auto pb = b.swls.points(i);
+
+		const auto &da = a.swts[i].dim;
+		const auto &db = b.swts[i].dim;
+
+		if (pa.count != pb.count || pa.step != pb.step || std::memcmp(pa.data, pb.data, pa.count * sizeof(LinePoint)))
+			return false;
+
+		if (da.x != db.x || da.y != db.y || da.w != db.w || da.h != db.h)
+			return false;
+
+		if (a.swlis[i].radius != b.swlis[i].radius || a.swlis[i].color.r != b.swlis[i].color.r)
+			return false;
+	}
+
+	for (size_t i = 0; i < a.txwts.size(); ++i)
+		if (text_string(a.txwtxis[i].text) != text_string(b.txwtxis[i].text) ||
+			a.txwts[i].dim.x != b.txwts[i].dim.x)
+			return false;
+
+	return true;
+}
+
+/**
+ * @brief Save, load back & compare a canvas, reporting size and time
+ */
+static auto round_trip(CanvasContext &c, const std::filesystem::path &file) -> bool
+{
+	using clock = std::chrono::steady_clock;
+	const auto ms = [](clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+	const auto t1 = clock::now();
+	save(c, file.string().c_str());
+
+	const auto	  t2 = clock::now();
+	CanvasContext l;
+	load(l, file.string().c_str());
+
+	const auto t3 = clock::now();
+	const auto ok = same(c, l);
+	const auto t4 = clock::now();
+
+	ctl::print("%-6s %10ju bytes, save %7.1f ms, load %7.1f ms, first read %7.1f ms%s\n",
+			   file.extension().string().c_str(), (uintmax_t)std::filesystem::file_size(file), ms(t2 - t1),
+			   ms(t3 - t2), ms(t4 - t3), ok ? "" : "  MISMATCH");
+
+	return ok;
+}
+
+auto main() -> int
+{
+	CanvasContext c;
+	generate(c);
+
+	const auto dir = std::filesystem::temp_directory_path();
+
+	auto ok = round_trip(c, dir / "notetaker_bench.bin");
+	ok &= round_trip(c, dir / "notetaker_bench.xml");
+
+	for (const auto *f : { "notetaker_bench.bin", "notetaker_bench.xml" }) std::filesystem::remove(dir / f);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include "canvas/stroke.h"
+
+/**
+ * @brief Check that the area of a stroke can hold a texture
+ */
+static auto check(std::span<const mth::Point<int>> ps, float rad, const char *name) -> bool
+{
+	const auto dim = get_path_dim(ps, rad);
+
+	if (dim.w > 0 && dim.h > 0)
+		return true;
+
+	ctl::print("%s: %dx%d area at radius %.2f\n", name, dim.w, dim.h, rad);
+	return false;
+}
+
+auto main() -> int
+{
+	const auto rad = 1.F * ZOOM_MIN; // Smallest radius at the lowest zoom
+
+	const mth::Point<int> dot[]	  = { { 5, 5 } };
+	const mth::Point<int> horiz[] = { { 0, 5 }, { 20, 5 } };
+	const mth::Point<int> vert[]  = { { 5, 0 }, { 5, 20 } };
+
+	auto ok = check(dot, rad, "Dot");
+	ok &= check(dot, 0.F, "Dot without radius");
+	ok &= check(horiz, rad, "Horizontal line");
+	ok &= check(vert, rad, "Vertical line");
+
+	return ok ? 0 : 1;
+}